@@ -0,0 +1,105 @@
+#include "corpus.h"
+#include "../cpp_parser.h" // for resolvePath()
+
+#include <fmt/format.h>
+
+#include <fstream>
+#include <stdexcept>
+
+#include <sys/stat.h>
+
+namespace {
+
+void writeFile(std::string const& name, std::string const& contents)
+{
+    std::ofstream out(name, std::ios::binary);
+    out << contents;
+    if (!out)
+        throw std::runtime_error("Could not write " + name);
+}
+
+bool isTemplate(unsigned n, double templates)
+{
+    // Spreads the templates evenly instead of putting them all first
+    return static_cast<unsigned>((n + 1) * templates) >
+           static_cast<unsigned>(n * templates);
+}
+
+std::string generateClass(unsigned n, CorpusOptions const& options)
+{
+    std::string code;
+    code += fmt::format("/// Class {} of the corpus.\n"
+                        "/// It does nothing, but documents it well.\n",
+                        n);
+    if (isTemplate(n, options.templates))
+        code += "template <typename T, int Size = 4>\n";
+    code += fmt::format("class Class{}\n{{\npublic:\n", n);
+    for (unsigned m = 0; m < options.methods; m++) {
+        code += fmt::format(
+            "    /// Method {} of class {}.\n"
+            "    /// \\param first The first argument\n"
+            "    /// \\param second The second argument\n"
+            "    int method{}(int first, const char* second) const;\n\n",
+            m, n, m);
+    }
+    code += "private:\n";
+    for (unsigned m = 0; m < options.methods; m++)
+        code += fmt::format("    /// Field {}\n    int field{}_ = {};\n", m, m, m);
+    code += "};\n\n";
+    return code;
+}
+
+} // namespace
+
+Corpus writeCorpus(std::string const& dir, CorpusOptions const& options)
+{
+    if (options.depth == 0)
+        throw std::invalid_argument("Corpus depth must be at least 1");
+    ::mkdir(dir.c_str(), 0755);
+
+    Corpus corpus;
+    corpus.dir = resolvePath(dir.c_str());
+    if (corpus.dir.empty())
+        throw std::runtime_error("Could not create " + dir);
+
+    std::vector<std::string> contents(options.depth);
+    for (unsigned i = 0; i < options.depth; i++) {
+        corpus.headers.push_back(fmt::format("{}/header{}.h", corpus.dir, i));
+        contents[i] = "#pragma once\n\n";
+        if (i + 1 < options.depth)
+            contents[i] += fmt::format("#include \"header{}.h\"\n\n", i + 1);
+        contents[i] += "namespace corpus {\n\n";
+    }
+    for (unsigned n = 0; n < options.classes; n++) {
+        contents[n % options.depth] += generateClass(n, options);
+        corpus.classes.push_back(fmt::format("corpus::Class{}", n));
+    }
+    for (unsigned i = 0; i < options.depth; i++)
+        writeFile(corpus.headers[i], contents[i] + "} // namespace corpus\n");
+
+    corpus.source = corpus.dir + "/corpus.cpp";
+    writeFile(corpus.source, "#include \"header0.h\"\n\nint main() {}\n");
+
+    writeFile(corpus.dir + "/compile_commands.json",
+              fmt::format("[{{\n"
+                          "  \"directory\": \"{0}\",\n"
+                          "  \"command\": \"clang++ -std=c++14 -I{0} -c {1}\",\n"
+                          "  \"file\": \"{1}\"\n"
+                          "}}]\n",
+                          corpus.dir, corpus.source));
+
+    std::string doc = "# Corpus\n\n@{ source(\"" + corpus.source + "\") }\n";
+    for (auto const& name : corpus.classes) {
+        doc += fmt::format("## {0}\n\n@{{ symbol(\"{0}\") }}"
+                           "@{{ print(doc_comment()) }}\n\n",
+                           name);
+        for (unsigned m = 0; m < options.methods; m++)
+            doc += fmt::format("* `method{0}`: @{{ method(\"method{0}\") "
+                               "print(doc_comment()) }}\n",
+                               m);
+        doc += "@{ enddoc() }\n";
+    }
+    corpus.templateFile = corpus.dir + "/corpus.dox";
+    writeFile(corpus.templateFile, doc);
+    return corpus;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+struct CorpusOptions
+{
+    // How deep the headers include each other, starting from the source file
+    unsigned depth = 4;
+    // Spread evenly over the headers
+    unsigned classes = 200;
+    // Fraction of the classes that are class templates
+    double templates = 0.25;
+    // Methods, and as many fields, per class
+    unsigned methods = 8;
+};
+
+struct Corpus
+{
+    std::string dir;
+    // The one translation unit; it includes the first header
+    std::string source;
+    std::vector<std::string> headers;
+    // Documents every class and method
+    std::string templateFile;
+    // Qualified names of the generated classes
+    std::vector<std::string> classes;
+};
+
+// Write a synthetic, documented C++ project to `dir`, together with a
+// compile_commands.json and a template for it. Files that are already there
+// are overwritten. The same options always give the same corpus.
+Corpus writeCorpus(std::string const& dir, CorpusOptions const& options);
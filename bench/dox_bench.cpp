@@ -0,0 +1,324 @@
+// Microbenchmarks for each phase of the dox pipeline, run on a generated
+// corpus. The corpus is kept, so the whole pipeline can be traced on it too:
+//
+//   dox_bench --corpus /tmp/corpus --classes 1000 --depth 8
+//   dox --project /tmp/corpus --trace trace.json /tmp/corpus/corpus.dox
+//
+// Catch options work as usual, e.g. `dox_bench "[preprocess]"`.
+
+#define CATCH_CONFIG_RUNNER
+#include <catch2/catch.hpp>
+
+#include "corpus.h"
+
+#include "../comment_scanner.h"
+#include "../cpp_parser.h"
+#include "../distill.h"
+#include "../lua_template.h"
+#include "../renderer.h"
+#include "../symbol_index.h"
+#include "../template_tokenizer.h"
+
+#include <coreutils/mapped_file.h>
+#include <coreutils/output_buffer.h>
+
+#include <cppast/libclang_parser.hpp>
+
+// Internal to cppast, but these are the parts worth measuring on their own
+#include <libclang/libclang_visitor.hpp>
+#include <libclang/preprocessor.hpp>
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+namespace {
+
+Corpus corpus;
+
+cppast::libclang_compile_config configFor(std::string const& file)
+{
+    cppast::libclang_compilation_database database(corpus.dir);
+    return cppast::libclang_compile_config(database, file);
+}
+
+size_t classCount(SymbolIndex const& symbols)
+{
+    auto all = symbols.withPrefix("");
+    return static_cast<size_t>(
+        std::count_if(all.begin(), all.end(), [](SymbolIndex::Symbol const& s) {
+            return s.kind == SymbolIndex::Kind::Class;
+        }));
+}
+
+// A header of the corpus, as cppast parses it for in-process preprocessing.
+// The source file itself declares nothing; the classes are in the headers.
+struct Unit
+{
+    std::string path;
+    std::string source = cppast::detail::read_source(path.c_str());
+    cppast::detail::cxindex index{clang_createIndex(0, 0)};
+    cppast::detail::cxtranslation_unit tu;
+
+    explicit Unit(std::string const& file) : path(file)
+    {
+        std::vector<const char*> args = {"-x", "c++", "-std=c++14"};
+        auto include = "-I" + corpus.dir;
+        args.push_back(include.c_str());
+        CXUnsavedFile unsaved{path.c_str(), source.c_str(),
+                              static_cast<unsigned long>(source.size())};
+        CXTranslationUnit unit = nullptr;
+        clang_parseTranslationUnit2(
+            index.get(), path.c_str(), args.data(),
+            static_cast<int>(args.size()), &unsaved, 1,
+            CXTranslationUnit_Incomplete | CXTranslationUnit_KeepGoing |
+                CXTranslationUnit_DetailedPreprocessingRecord,
+            &unit);
+        REQUIRE(unit);
+        tu = cppast::detail::cxtranslation_unit(unit);
+    }
+};
+
+std::vector<std::unique_ptr<Unit>> headerUnits()
+{
+    REQUIRE(!corpus.headers.empty());
+    std::vector<std::unique_ptr<Unit>> units;
+    for (auto const& header : corpus.headers)
+        units.push_back(std::make_unique<Unit>(header));
+    return units;
+}
+
+} // namespace
+
+TEST_CASE("template", "[template]")
+{
+    utils::MappedFile mapped(corpus.templateFile);
+    auto doc = mapped.view();
+    REQUIRE(!doc.empty());
+
+    BENCHMARK("tokenize")
+    {
+        TemplateTokenizer tokenizer(doc);
+        Segment segment;
+        size_t count = 0;
+        while (tokenizer.next(segment))
+            count++;
+        REQUIRE(count > 0);
+    }
+    BENCHMARK("compileTemplate")
+    {
+        REQUIRE(!compileTemplate(doc).empty());
+    }
+    BENCHMARK("findReferences")
+    {
+        REQUIRE(findReferences(doc).symbols.size() >= corpus.classes.size());
+    }
+}
+
+TEST_CASE("preprocess", "[preprocess]")
+{
+    cppast::stderr_diagnostic_logger logger;
+    auto units = headerUnits();
+
+    BENCHMARK("detail::preprocess in process, every header")
+    {
+        for (auto const& unit : units) {
+            auto output = cppast::detail::preprocess(
+                unit->tu, unit->path.c_str(), unit->source, logger);
+            REQUIRE(!output.source.empty());
+        }
+    }
+
+    auto config = configFor(corpus.source);
+    config.in_process_preprocessing(false);
+    BENCHMARK("detail::preprocess with clang -E, every header")
+    {
+        for (auto const& header : corpus.headers) {
+            auto output =
+                cppast::detail::preprocess(config, header.c_str(), logger);
+            REQUIRE(!output.source.empty());
+        }
+    }
+}
+
+TEST_CASE("visit_tu", "[visit_tu]")
+{
+    auto units = headerUnits();
+    BENCHMARK("detail::visit_tu, every header")
+    {
+        size_t count = 0;
+        for (auto const& unit : units)
+            cppast::detail::visit_tu(unit->tu, unit->path.c_str(),
+                                     [&](CXCursor const&) { count++; });
+        REQUIRE(count >= corpus.classes.size());
+    }
+}
+
+TEST_CASE("parse", "[parse]")
+{
+    cppast::stderr_diagnostic_logger logger;
+    cppast::libclang_parser parser(type_safe::ref(logger));
+    auto config = configFor(corpus.source);
+
+    std::unordered_map<std::string, FileModel> models;
+    BENCHMARK("libclang_parser::parse and distill, every header")
+    {
+        models.clear();
+        cppast::cpp_entity_index index;
+        for (auto const& header : corpus.headers) {
+            auto file = parser.parse(index, header, config);
+            REQUIRE(file);
+            auto model = distill(*file);
+            models[model.path] = std::move(model);
+        }
+    }
+
+    SymbolIndex symbols;
+    symbols.build(models);
+    REQUIRE(classCount(symbols) >= corpus.classes.size());
+    BENCHMARK("SymbolIndex::build")
+    {
+        symbols.build(models);
+    }
+}
+
+namespace {
+
+// Entities of `parsed` or `scanned`, and how many of them both have exactly
+// the same
+std::pair<size_t, size_t> compare(FileModel const& parsed,
+                                  FileModel const& scanned)
+{
+    auto sameVars = [](std::vector<Var> const& a, std::vector<Var> const& b) {
+        if (a.size() != b.size())
+            return false;
+        for (size_t i = 0; i < a.size(); i++)
+            if (a[i].name != b[i].name || a[i].type != b[i].type ||
+                a[i].doc != b[i].doc)
+                return false;
+        return true;
+    };
+    size_t total = 0;
+    size_t same = 0;
+    for (auto const& c : parsed.classes) {
+        total += 1 + c.methods.size() + c.fields.size();
+        auto it = std::find_if(
+            scanned.classes.begin(), scanned.classes.end(),
+            [&](Class const& s) { return s.ns == c.ns && s.name == c.name; });
+        if (it == scanned.classes.end())
+            continue;
+        same += it->doc == c.doc;
+        for (size_t i = 0; i < c.methods.size() && i < it->methods.size(); i++) {
+            auto const& m = c.methods[i];
+            auto const& s = it->methods[i];
+            same += m.name == s.name && m.doc == s.doc &&
+                    sameVars(m.params, s.params);
+        }
+        for (size_t i = 0; i < c.fields.size() && i < it->fields.size(); i++)
+            same += sameVars({c.fields[i]}, {it->fields[i]});
+    }
+    // And what only the scanner found
+    for (auto const& s : scanned.classes) {
+        auto it = std::find_if(
+            parsed.classes.begin(), parsed.classes.end(),
+            [&](Class const& c) { return c.ns == s.ns && c.name == s.name; });
+        if (it == parsed.classes.end()) {
+            total += 1 + s.methods.size() + s.fields.size();
+            continue;
+        }
+        if (s.methods.size() > it->methods.size())
+            total += s.methods.size() - it->methods.size();
+        if (s.fields.size() > it->fields.size())
+            total += s.fields.size() - it->fields.size();
+    }
+    return {total, same};
+}
+
+} // namespace
+
+TEST_CASE("scan", "[scan]")
+{
+    cppast::stderr_diagnostic_logger logger;
+    cppast::libclang_parser parser(type_safe::ref(logger));
+    auto config = configFor(corpus.source);
+
+    std::vector<FileModel> parsed;
+    BENCHMARK("libclang_parser::parse and distill, every header")
+    {
+        parsed.clear();
+        cppast::cpp_entity_index index;
+        for (auto const& header : corpus.headers) {
+            auto file = parser.parse(index, header, config);
+            REQUIRE(file);
+            parsed.push_back(distill(*file));
+        }
+    }
+
+    CommentScanner scanner;
+    std::vector<FileModel> scanned;
+    BENCHMARK("CommentScanner::scan, every header")
+    {
+        scanned.clear();
+        for (auto const& header : corpus.headers) {
+            auto model = scanner.scan(header);
+            INFO(header << ": " << scanner.reason());
+            REQUIRE(model);
+            scanned.push_back(std::move(*model));
+        }
+    }
+
+    // The scanner is only worth it if it gets the same result
+    REQUIRE(scanned.size() == parsed.size());
+    size_t total = 0;
+    size_t same = 0;
+    for (size_t i = 0; i < parsed.size(); i++) {
+        auto counts = compare(parsed[i], scanned[i]);
+        total += counts.first;
+        same += counts.second;
+    }
+    fmt::print("CommentScanner::scan agrees on {} of {} entities\n", same,
+               total);
+    CHECK(same == total);
+}
+
+TEST_CASE("render", "[render]")
+{
+    // Parses the headers the source includes as well
+    CppParser parser{corpus.dir};
+    parser.loadProject();
+    REQUIRE(classCount(parser.symbols()) >= corpus.classes.size());
+    utils::MappedFile mapped(corpus.templateFile);
+    Renderer renderer;
+
+    BENCHMARK("Renderer::render")
+    {
+        utils::OutputBuffer out("/dev/null");
+        renderer.render(parser, corpus.templateFile, mapped.view(), out,
+                        nullptr);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Catch::Session session;
+    std::string dir = "dox_bench_corpus";
+    CorpusOptions options;
+
+    using Catch::clara::Opt;
+    session.cli(
+        session.cli() |
+        Opt(dir, "dir")["--corpus"]("where to write the corpus") |
+        Opt(options.depth, "n")["--depth"]("how deep headers are nested") |
+        Opt(options.classes, "n")["--classes"]("number of classes") |
+        Opt(options.templates, "fraction")["--templates"](
+            "fraction of the classes that are templates") |
+        Opt(options.methods, "n")["--methods"]("methods per class"));
+    if (auto result = session.applyCommandLine(argc, argv))
+        return result;
+
+    corpus = writeCorpus(dir, options);
+    return session.run();
+}
@@ -0,0 +1,76 @@
+// Measures how fast a large generated template is split into segments and
+// written out, without running any Lua.
+//
+// Usage: template_bench [megabytes] [output file]
+
+#include "../template_tokenizer.h"
+
+#include <coreutils/mapped_file.h>
+#include <coreutils/output_buffer.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+namespace {
+
+void generate(std::string const& name, size_t megabytes)
+{
+    auto* f = std::fopen(name.c_str(), "wb");
+    if (!f) {
+        std::perror(name.c_str());
+        std::exit(1);
+    }
+    std::string block;
+    for (int i = 0; i < 64; i++) {
+        block += "## Class Foo" + std::to_string(i) +
+                 "\n\nSome text about the class, with an @ sign and "
+                 "{braces} that are not code.\n\n";
+        block += "@{ print(\"}\" .. 'it\\'s') t = { a = { 1, 2 } } }\n";
+        block += "@{ -- comment with a } brace\nsymbol(\"Foo\") }\n";
+    }
+    size_t total = megabytes << 20;
+    for (size_t written = 0; written < total; written += block.size())
+        std::fwrite(block.data(), 1, block.size(), f);
+    std::fclose(f);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    size_t megabytes = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 256;
+    std::string outFile = argc > 2 ? argv[2] : "/dev/null";
+    std::string input = "template_bench.dox";
+
+    generate(input, megabytes);
+
+    auto start = std::chrono::steady_clock::now();
+    size_t text = 0;
+    size_t code = 0;
+    {
+        utils::MappedFile mapped(input);
+        utils::OutputBuffer out(outFile);
+        TemplateTokenizer tokenizer(mapped.view());
+        Segment segment;
+        while (tokenizer.next(segment)) {
+            if (segment.kind == Segment::Code) {
+                code++;
+            } else {
+                text++;
+                out.write(segment.text);
+            }
+        }
+        out.flush();
+    }
+    std::chrono::duration<double> seconds =
+        std::chrono::steady_clock::now() - start;
+    std::remove(input.c_str());
+
+    std::printf("%zu MB, %zu text and %zu code segments in %.3f s "
+                "(%.0f MB/s)\n",
+                megabytes, text, code, seconds.count(),
+                static_cast<double>(megabytes) / seconds.count());
+    return 0;
+}
@@ -0,0 +1,1107 @@
+#include "comment_scanner.h"
+#include "cpp_parser.h" // for resolvePath()
+
+#include <coreutils/mapped_file.h>
+
+#include <fmt/format.h>
+
+// Internal to cppast; the same tokenizer and doc comment parser as a full
+// parse, so comments come out exactly the same
+#include <libclang/cxtokenizer.hpp>
+#include <libclang/preprocessor.hpp>
+
+#include <cctype>
+#include <unordered_set>
+
+namespace {
+
+// Thrown to give up on a file
+struct Unsure
+{
+    std::string reason;
+};
+
+using Tokens = std::vector<ScanToken const*>;
+
+bool isBuiltin(std::string const& word)
+{
+    static const std::unordered_set<std::string> builtins = {
+        "void",     "bool",     "char",  "wchar_t", "char8_t",
+        "char16_t", "char32_t", "short", "int",     "long",
+        "signed",   "unsigned", "float", "double"};
+    return builtins.count(word) > 0;
+}
+
+bool isSpecifier(std::string const& word)
+{
+    static const std::unordered_set<std::string> specifiers = {
+        "static",   "virtual",   "inline",       "constexpr", "explicit",
+        "mutable",  "extern",    "thread_local", "friend",    "consteval",
+        "constinit"};
+    return specifiers.count(word) > 0;
+}
+
+bool isIdentifierChar(char c)
+{
+    return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+}
+
+// Tokens the way cppast joins them: a space only where two words meet
+std::string joinTokens(std::vector<std::string> const& tokens)
+{
+    std::string result;
+    for (auto const& token : tokens) {
+        if (!result.empty() && isIdentifierChar(result.back()) &&
+            isIdentifierChar(token[0]))
+            result += ' ';
+        result += token;
+    }
+    return result;
+}
+
+std::string join(std::vector<std::string> const& scope)
+{
+    std::string result;
+    for (auto const& s : scope) {
+        if (!result.empty())
+            result += "::";
+        result += s;
+    }
+    return result;
+}
+
+// Builtin type keywords, in any order, as cppast spells the type
+std::string builtinName(std::vector<std::string> const& words)
+{
+    int nUnsigned = 0, nSigned = 0, nShort = 0, nLong = 0, nInt = 0;
+    std::string other;
+    for (auto const& word : words) {
+        if (word == "unsigned")
+            nUnsigned++;
+        else if (word == "signed")
+            nSigned++;
+        else if (word == "short")
+            nShort++;
+        else if (word == "long")
+            nLong++;
+        else if (word == "int")
+            nInt++;
+        else if (other.empty())
+            other = word;
+        else
+            throw Unsure{"builtin type '" + joinTokens(words) + "'"};
+    }
+    bool valid = nUnsigned + nSigned <= 1 && nShort <= 1 && nLong <= 2 &&
+                 nInt <= 1 && !(nShort && nLong);
+    if (valid && other.empty()) {
+        std::string name = nUnsigned ? "unsigned " : "";
+        if (nShort)
+            return name + "short";
+        if (nLong == 2)
+            return name + "long long";
+        if (nLong == 1)
+            return name + "long";
+        return name + "int";
+    }
+    if (valid && other == "char" && !nShort && !nLong && !nInt)
+        return nUnsigned ? "unsigned char" : nSigned ? "signed char" : "char";
+    if (valid && other == "double" && nLong <= 1 &&
+        nUnsigned + nSigned + nShort + nInt == 0)
+        return nLong ? "long double" : "double";
+    if (valid && nUnsigned + nSigned + nShort + nLong + nInt == 0)
+        return other;
+    throw Unsure{"builtin type '" + joinTokens(words) + "'"};
+}
+
+class Scanner
+{
+public:
+    Scanner(std::string const& path, std::string_view source,
+            std::vector<ScanToken> const& tokens)
+        : path_(path), source_(source), tokens_(tokens)
+    {
+        model_.path = path;
+    }
+
+    FileModel run()
+    {
+        split();
+        std::vector<std::string> scope;
+        declarations(scope, false);
+        return std::move(model_);
+    }
+
+private:
+    enum class Guard
+    {
+        None,
+        Expected, // After the #ifndef, before the #define
+        Open,
+        Closed
+    };
+
+    [[noreturn]] void unsure(std::string const& what, ScanToken const& at)
+    {
+        if (at.line == 0)
+            throw Unsure{what + " at the end"};
+        throw Unsure{fmt::format("{} on line {}", what, at.line)};
+    }
+
+    //=== Comments and directives ===//
+
+    // Sort the tokens into doc comments, directives and code
+    void split()
+    {
+        for (size_t i = 0; i < tokens_.size();) {
+            auto const& t = tokens_[i];
+            if (t.kind == ScanToken::Comment) {
+                cppast::detail::parse_doc_comment(comments_, t.spelling.c_str(),
+                                                  t.line, t.column);
+                i++;
+            } else if (t.spelling == "#" &&
+                       (i == 0 || tokens_[i - 1].line != t.line)) {
+                i = directive(i);
+            } else {
+                if (t.kind == ScanToken::Identifier && macros_.count(t.spelling))
+                    unsure("uses the macro " + t.spelling, t);
+                if (guard_ == Guard::Expected)
+                    unsure("#ifndef that is not an include guard", t);
+                if (guard_ == Guard::Closed)
+                    unsure("code after the include guard", t);
+                code_.push_back(&t);
+                i++;
+            }
+        }
+        if (guard_ != Guard::None && guard_ != Guard::Closed)
+            throw Unsure{"unterminated #ifndef"};
+    }
+
+    // Whether `line` ends with a backslash, and so goes on on the next one
+    bool continues(unsigned line)
+    {
+        if (lineStarts_.empty()) {
+            lineStarts_.push_back(0);
+            for (auto p = source_.find('\n'); p != std::string_view::npos;
+                 p = source_.find('\n', p + 1))
+                lineStarts_.push_back(p + 1);
+        }
+        if (line == 0 || line >= lineStarts_.size())
+            return false;
+        auto text = source_.substr(lineStarts_[line - 1],
+                                   lineStarts_[line] - 1 - lineStarts_[line - 1]);
+        while (!text.empty() && text.back() == '\r')
+            text.remove_suffix(1);
+        return !text.empty() && text.back() == '\\';
+    }
+
+    // Handle the directive starting with the '#' at `i`. Returns the index of
+    // the token after it.
+    size_t directive(size_t i)
+    {
+        auto const& hash = tokens_[i];
+        auto last = hash.line;
+        while (continues(last))
+            last++;
+        Tokens words;
+        size_t end = i + 1;
+        for (; end < tokens_.size() && tokens_[end].line <= last; end++) {
+            auto const& t = tokens_[end];
+            if (t.kind == ScanToken::Comment)
+                cppast::detail::parse_doc_comment(comments_, t.spelling.c_str(),
+                                                  t.line, t.column);
+            else
+                words.push_back(&t);
+        }
+        if (words.empty())
+            return end;
+
+        bool expected = guard_ == Guard::Expected;
+        auto const& name = words[0]->spelling;
+        if (name == "include")
+            include(words);
+        else if (name == "define" && words.size() >= 2) {
+            if (expected && words.size() == 2 &&
+                words[1]->spelling == guardMacro_)
+                guard_ = Guard::Open;
+            else
+                macros_.insert(words[1]->spelling);
+        } else if (name == "ifndef" && words.size() == 2 &&
+                   guard_ == Guard::None && code_.empty()) {
+            guard_ = Guard::Expected;
+            guardMacro_ = words[1]->spelling;
+        } else if (name == "endif" && guard_ == Guard::Open)
+            guard_ = Guard::Closed;
+        else if (name != "pragma" && name != "undef")
+            unsure("#" + name, hash);
+        if (expected && guard_ != Guard::Open)
+            unsure("#ifndef that is not an include guard", hash);
+        return end;
+    }
+
+    void include(Tokens const& words)
+    {
+        auto const& file = words.size() > 1 ? *words[1] : *words[0];
+        if (words.size() == 2 && file.kind == ScanToken::Literal &&
+            file.spelling.size() > 2 && file.spelling[0] == '"') {
+            // Only what the compiler looks at first; anything else needs
+            // the include paths
+            auto name = file.spelling.substr(1, file.spelling.size() - 2);
+            auto slash = path_.rfind('/');
+            auto full = name[0] == '/'
+                            ? resolvePath(name.c_str())
+                            : resolvePath(
+                                  (path_.substr(0, slash + 1) + name).c_str());
+            if (full.empty())
+                unsure("can not find \"" + name + "\" next to the file", file);
+            model_.includes.push_back({full, false});
+        } else if (words.size() < 3 || file.spelling != "<")
+            unsure("#include of a macro", file);
+        // System headers are not followed, so there is no need for them
+    }
+
+    //=== Tokens of the code ===//
+
+    ScanToken const& peek(size_t n = 0) const
+    {
+        static const ScanToken end{ScanToken::Punctuation, "", 0, 0};
+        return pos_ + n < code_.size() ? *code_[pos_ + n] : end;
+    }
+
+    bool is(char const* text, size_t n = 0) const
+    {
+        return peek(n).spelling == text;
+    }
+
+    bool atEnd() const { return pos_ >= code_.size(); }
+
+    ScanToken const& next()
+    {
+        if (atEnd())
+            unsure("unexpected end of the file", peek());
+        return *code_[pos_++];
+    }
+
+    void expect(char const* text)
+    {
+        if (!is(text))
+            unsure(fmt::format("expected '{}'", text), peek());
+        pos_++;
+    }
+
+    bool isClassKey() const
+    {
+        return is("class") || is("struct") || is("union");
+    }
+
+    // Skip from an opening bracket to its closing one
+    void skipBalanced()
+    {
+        int depth = 0;
+        do {
+            auto const& s = next().spelling;
+            if (s == "(" || s == "[" || s == "{")
+                depth++;
+            else if (s == ")" || s == "]" || s == "}")
+                depth--;
+        } while (depth > 0);
+    }
+
+    // Skip template parameters or arguments, from the '<'. Returns the
+    // tokens skipped.
+    Tokens skipAngles()
+    {
+        auto from = pos_;
+        int depth = 0;
+        do {
+            if (is("(") || is("[") || is("{")) {
+                skipBalanced();
+                continue;
+            }
+            auto const& t = next();
+            if (t.spelling == "<")
+                depth++;
+            else if (t.spelling == ">")
+                depth--;
+            else if (t.spelling == ">>")
+                depth -= 2;
+            else if (t.spelling == ";" || t.spelling == "}")
+                unsure("unbalanced '<'", t);
+        } while (depth > 0);
+        if (depth < 0)
+            unsure("unbalanced '>'", peek());
+        return Tokens(code_.begin() + static_cast<ptrdiff_t>(from),
+                      code_.begin() + static_cast<ptrdiff_t>(pos_));
+    }
+
+    // The doc comment of an entity that starts on `line`, matched the way
+    // cppast does. Comments before it that nothing matched are dropped.
+    std::string docAt(unsigned line)
+    {
+        while (comment_ < comments_.size() && comments_[comment_].line + 1 < line)
+            comment_++;
+        if (comment_ == comments_.size())
+            return {};
+        auto& comment = comments_[comment_];
+        bool matches = comment.kind == cppast::detail::pp_doc_comment::end_of_line
+                           ? comment.line == line
+                           : comment.line + 1 == line;
+        if (!matches)
+            return {};
+        comment_++;
+        return std::move(comment.comment);
+    }
+
+    //=== Declarations ===//
+
+    // Namespace scope, up to the closing brace if `braced`
+    void declarations(std::vector<std::string>& scope, bool braced)
+    {
+        while (true) {
+            auto const& t = peek();
+            auto const& s = t.spelling;
+            if (atEnd()) {
+                if (braced)
+                    unsure("missing '}'", t);
+                return;
+            }
+            if (s == "}") {
+                if (!braced)
+                    unsure("unexpected '}'", t);
+                return;
+            }
+            if (s == ";")
+                next();
+            else if (s == "namespace" || (s == "inline" && is("namespace", 1)))
+                namespaceDefinition(scope);
+            else if (s == "extern" && peek(1).kind == ScanToken::Literal &&
+                     is("{", 2)) {
+                // Linkage specifications do not add a scope
+                docAt(t.line);
+                pos_ += 3;
+                declarations(scope, true);
+                expect("}");
+            } else if (s == "template") {
+                docAt(t.line);
+                templateHeader();
+                if (!isClassKey() || !classDefinition(scope, t.line, true))
+                    skipDeclaration();
+            } else if (isClassKey() && classDefinition(scope, t.line, false)) {
+            } else if (s == "enum")
+                enumDeclaration();
+            else {
+                docAt(t.line);
+                skipDeclaration();
+            }
+        }
+    }
+
+    void namespaceDefinition(std::vector<std::string>& scope)
+    {
+        auto line = peek().line;
+        if (is("inline"))
+            next();
+        expect("namespace");
+        docAt(line);
+        auto const& name = next();
+        if (name.kind != ScanToken::Identifier)
+            unsure("anonymous namespace", name);
+        if (is("=")) {
+            skipDeclaration();
+            return;
+        }
+        if (!is("{"))
+            unsure("nested namespace definition", peek());
+        next();
+        scope.push_back(name.spelling);
+        declarations(scope, true);
+        expect("}");
+        scope.pop_back();
+    }
+
+    void templateHeader()
+    {
+        expect("template");
+        if (!is("<"))
+            unsure("explicit instantiation", peek());
+        skipAngles();
+    }
+
+    // A function, variable or anything else that is not recorded, up to
+    // and including its ';' or body
+    void skipDeclaration()
+    {
+        bool initializer = false;
+        bool classKey = false;
+        while (true) {
+            auto const& t = peek();
+            auto const& s = t.spelling;
+            if (s == ";") {
+                next();
+                return;
+            }
+            if (s == "(" || s == "[") {
+                skipBalanced();
+                continue;
+            }
+            if (s == "{") {
+                // Whatever is in front of the class name, it is not one we
+                // know about
+                if (classKey)
+                    unsure("class defined inside a declaration", t);
+                skipBalanced();
+                if (!initializer) {
+                    // A function body, or braces around an initial value
+                    if (is(";"))
+                        next();
+                    return;
+                }
+                continue;
+            }
+            if (s == "}")
+                unsure("unexpected '}'", t);
+            if (s == "=")
+                initializer = true;
+            if (s == "class" || s == "struct" || s == "union" || s == "enum")
+                classKey = true;
+            next();
+        }
+    }
+
+    void enumDeclaration()
+    {
+        docAt(peek().line);
+        while (!is(";") && !is("{"))
+            next();
+        if (is("{")) {
+            // The enumerators take their comments with them
+            skipBalanced();
+            if (!is(";"))
+                unsure("variable of an enum defined in place", peek());
+        }
+        next();
+    }
+
+    // At the class key. Returns false, and leaves the position alone, if
+    // it is not a class definition that is sure to be read correctly.
+    bool classDefinition(std::vector<std::string>& scope, unsigned line,
+                         bool templated)
+    {
+        auto start = pos_;
+        next();
+        if (is("{"))
+            unsure("anonymous class", peek());
+        auto const& name = next();
+        if (name.kind != ScanToken::Identifier) {
+            pos_ = start;
+            return false;
+        }
+        if (is("final"))
+            next();
+        if (!is("{") && !is(":")) {
+            // Declared, specialized, or with something before the name
+            pos_ = start;
+            return false;
+        }
+        while (!is("{")) {
+            // Base classes
+            if (is(";") || atEnd())
+                unsure("expected '{'", peek());
+            if (is("<"))
+                skipAngles();
+            else
+                next();
+        }
+        next();
+
+        auto index = model_.classes.size();
+        model_.classes.emplace_back(join(scope), name.spelling);
+        // cppast gives the comment of a template to the template instead
+        if (!templated)
+            model_.classes[index].doc = docAt(line);
+
+        scope.push_back(name.spelling);
+        members(scope, index, name.spelling);
+        scope.pop_back();
+        expect("}");
+        if (!is(";"))
+            unsure("variable of a class defined in place", peek());
+        next();
+        return true;
+    }
+
+    void members(std::vector<std::string>& scope, size_t index,
+                 std::string const& className)
+    {
+        while (!is("}")) {
+            auto const& t = peek();
+            auto const& s = t.spelling;
+            if (atEnd())
+                unsure("missing '}'", t);
+            if ((s == "public" || s == "protected" || s == "private") &&
+                is(":", 1)) {
+                pos_ += 2;
+                continue;
+            }
+            if (s == ";") {
+                next();
+                continue;
+            }
+            if (s == "friend" || s == "using" || s == "typedef" ||
+                s == "static_assert" || s == "~") {
+                docAt(t.line);
+                skipDeclaration();
+                continue;
+            }
+            if (s == "enum") {
+                enumDeclaration();
+                continue;
+            }
+            bool templated = false;
+            if (s == "template") {
+                docAt(t.line);
+                templateHeader();
+                templated = true;
+            }
+            if (isClassKey()) {
+                if (!classDefinition(scope, t.line, templated))
+                    unsure("member of an elaborated class type", peek());
+                continue;
+            }
+            member(index, className, t.line, templated);
+        }
+    }
+
+    // A method or a field
+    void member(size_t index, std::string const& className, unsigned line,
+                bool templated)
+    {
+        // The specifiers, the type and the name
+        Tokens head;
+        std::string op;
+        while (true) {
+            auto const& t = peek();
+            auto const& s = t.spelling;
+            if (s == "operator") {
+                op = operatorName();
+                break;
+            }
+            if (s == "(" || s == "=" || s == ";" || s == "{" || s == "[" ||
+                s == ":")
+                break;
+            if (s == "<") {
+                auto arguments = skipAngles();
+                head.insert(head.end(), arguments.begin(), arguments.end());
+                continue;
+            }
+            if (s == "}" || s == "," || atEnd())
+                unsure(fmt::format("unexpected '{}'", s), t);
+            head.push_back(&t);
+            next();
+        }
+
+        bool isStatic = false;
+        Tokens type;
+        for (auto* t : head) {
+            if (t->spelling == "static")
+                isStatic = true;
+            if (!isSpecifier(t->spelling))
+                type.push_back(t);
+        }
+        if (!op.empty() || is("("))
+            method(index, className, line, templated, isStatic, op, type);
+        else
+            field(index, line, templated, isStatic, type);
+    }
+
+    void method(size_t index, std::string const& className, unsigned line,
+                bool templated, bool isStatic, std::string name, Tokens type)
+    {
+        bool destructor = false;
+        if (name.empty()) {
+            if (type.empty() || type.back()->kind != ScanToken::Identifier)
+                unsure("expected a name", peek());
+            name = type.back()->spelling;
+            type.pop_back();
+            destructor = !type.empty() && type.back()->spelling == "~";
+        }
+        if (!destructor && type.empty() && name.compare(0, 8, "operator") != 0 &&
+            name != className)
+            unsure("'" + name + "' looks like a macro", peek());
+        for (size_t i = 1; i < type.size(); i++) {
+            // Nothing can come between two names but a macro
+            auto const& a = *type[i - 1];
+            auto const& b = *type[i];
+            bool aName = a.kind == ScanToken::Identifier || isBuiltin(a.spelling);
+            bool bName = b.kind == ScanToken::Identifier || isBuiltin(b.spelling);
+            if (aName && bName && !(isBuiltin(a.spelling) && isBuiltin(b.spelling)))
+                unsure("'" + a.spelling + "' looks like a macro", a);
+        }
+
+        auto doc = templated ? std::string() : docAt(line);
+        auto params = parameters();
+        functionSuffix();
+        // cppast makes static methods functions, and distill() leaves them
+        // out, like destructors
+        if (!isStatic && !destructor)
+            model_.classes[index].methods.push_back(
+                {std::move(name), std::move(params), std::move(doc)});
+    }
+
+    // From the 'operator' up to the parameters, as clang spells the name
+    std::string operatorName()
+    {
+        auto const& start = next();
+        if (is("(") && is(")", 1)) {
+            pos_ += 2;
+            return "operator()";
+        }
+        if (is("new") || is("delete")) {
+            auto name = "operator " + next().spelling;
+            if (is("[") && is("]", 1)) {
+                pos_ += 2;
+                name += "[]";
+            }
+            return name;
+        }
+        if (peek().kind == ScanToken::Literal)
+            unsure("literal operator", start);
+        if (peek().kind == ScanToken::Punctuation) {
+            std::string name = "operator";
+            while (!is("(")) {
+                auto const& t = next();
+                if (t.kind != ScanToken::Punctuation)
+                    unsure("operator name", t);
+                name += t.spelling;
+            }
+            return name;
+        }
+        // A conversion; cppast spells the type as it is written
+        std::vector<std::string> type;
+        while (!is("(")) {
+            auto const& t = next();
+            if (t.spelling == ";" || t.spelling == "{" || t.spelling == "}")
+                unsure("conversion operator", t);
+            type.push_back(t.spelling);
+        }
+        return "operator " + joinTokens(type);
+    }
+
+    std::vector<Var> parameters()
+    {
+        expect("(");
+        std::vector<Var> params;
+        if (is("void") && is(")", 1))
+            next();
+        if (is(")")) {
+            next();
+            return params;
+        }
+        while (true) {
+            Tokens tokens;
+            bool defaulted = false;
+            while (!is(",") && !is(")")) {
+                auto const& t = peek();
+                auto const& s = t.spelling;
+                if (atEnd() || s == ";" || s == "}")
+                    unsure("unterminated parameters", t);
+                if (s == "=") {
+                    defaulted = true;
+                    next();
+                } else if (defaulted) {
+                    // Without types, '<' is a template or a comparison
+                    if (s == "<")
+                        unsure("'<' in a default argument", t);
+                    if (s == "(" || s == "[" || s == "{")
+                        skipBalanced();
+                    else
+                        next();
+                } else if (s == "<") {
+                    auto arguments = skipAngles();
+                    tokens.insert(tokens.end(), arguments.begin(),
+                                  arguments.end());
+                } else if (s == "(" || s == "[") {
+                    unsure("function or array parameter", t);
+                } else {
+                    tokens.push_back(&t);
+                    next();
+                }
+            }
+            bool last = is(")");
+            next();
+            if (tokens.size() == 1 && tokens[0]->spelling == "...") {
+                // C variadic; cppast does not make it a parameter
+                if (!last)
+                    unsure("'...' before the last parameter", *tokens[0]);
+            } else
+                params.push_back(parameter(tokens));
+            if (last)
+                return params;
+        }
+    }
+
+    Var parameter(Tokens tokens)
+    {
+        if (tokens.empty())
+            unsure("empty parameter", peek());
+        for (auto* t : tokens)
+            if (t->spelling == "...")
+                unsure("parameter pack", *t);
+        Var var;
+        auto size = tokens.size();
+        if (size >= 2 && tokens[size - 1]->kind == ScanToken::Identifier &&
+            tokens[size - 2]->spelling != "::") {
+            // Unless the name is all there is of the type
+            for (size_t i = 0; i + 1 < size; i++) {
+                auto const& t = *tokens[i];
+                if (t.kind == ScanToken::Identifier || isBuiltin(t.spelling) ||
+                    t.spelling == "auto") {
+                    var.name = tokens.back()->spelling;
+                    tokens.pop_back();
+                    break;
+                }
+            }
+        }
+        var.type = typeName(tokens);
+        return var;
+    }
+
+    // After the parameters, up to and including the ';' or the body
+    void functionSuffix()
+    {
+        while (true) {
+            auto const& t = peek();
+            auto const& s = t.spelling;
+            if (s == ";") {
+                next();
+                return;
+            }
+            if (s == "{") {
+                skipBalanced();
+                if (is(";"))
+                    next();
+                return;
+            }
+            if (s == "=") {
+                // Pure, defaulted or deleted
+                pos_ += 2;
+                expect(";");
+                return;
+            }
+            if (s == ":")
+                constructorInitializers();
+            else if (s == "(")
+                skipBalanced(); // of noexcept() or throw()
+            else if (s == "->") {
+                // Trailing return type
+                next();
+                while (!is(";") && !is("{") && !is("=")) {
+                    if (is("<"))
+                        skipAngles();
+                    else if (is("("))
+                        skipBalanced();
+                    else
+                        next();
+                }
+            } else if (s == "const" || s == "volatile" || s == "&" ||
+                       s == "&&" || s == "noexcept" || s == "throw" ||
+                       s == "override" || s == "final")
+                next();
+            else
+                unsure(fmt::format("unexpected '{}' after the parameters", s),
+                       t);
+        }
+    }
+
+    // From the ':' up to the body
+    void constructorInitializers()
+    {
+        expect(":");
+        while (true) {
+            while (!is("(") && !is("{")) {
+                if (atEnd() || is(";") || is("}"))
+                    unsure("unterminated initializers", peek());
+                if (is("<"))
+                    skipAngles();
+                else
+                    next();
+            }
+            skipBalanced();
+            if (is("..."))
+                next();
+            if (is("{"))
+                return;
+            expect(",");
+        }
+    }
+
+    void field(size_t index, unsigned line, bool templated, bool isStatic,
+               Tokens type)
+    {
+        if (type.empty() || type.back()->kind != ScanToken::Identifier)
+            unsure("expected a name", peek());
+        auto name = type.back()->spelling;
+        type.pop_back();
+        if (is("["))
+            unsure("array member", peek());
+        bool bitfield = is(":");
+        // The initial value
+        while (!is(";")) {
+            auto const& t = peek();
+            if (atEnd() || t.spelling == "}")
+                unsure("unterminated member", t);
+            if (t.spelling == ",")
+                unsure("more than one declarator", t);
+            if (t.spelling == "(" || t.spelling == "[" || t.spelling == "{")
+                skipBalanced();
+            else
+                next();
+        }
+        next();
+
+        auto doc = templated ? std::string() : docAt(line);
+        // cppast makes static members and variable templates variables, and
+        // bit fields are their own kind; distill() leaves all of them out
+        if (!isStatic && !bitfield && !templated)
+            model_.classes[index].fields.push_back(
+                {std::move(name), typeName(type), std::move(doc)});
+    }
+
+    //=== Types ===//
+
+    // The type as cppast::to_string() spells it: const after what it
+    // applies to, and no spaces around '*' and '&'. Only the simple forms;
+    // anything else can not be spelled the same without clang.
+    std::string typeName(Tokens const& tokens)
+    {
+        size_t i = 0;
+        auto at = [&](size_t n) -> std::string const& {
+            static const std::string none;
+            return n < tokens.size() ? tokens[n]->spelling : none;
+        };
+        auto fail = [&]() {
+            std::vector<std::string> spelling;
+            for (auto* t : tokens)
+                spelling.push_back(t->spelling);
+            unsure("type '" + joinTokens(spelling) + "'",
+                   tokens.empty() ? peek() : *tokens[0]);
+        };
+        bool isConst = false, isVolatile = false;
+        auto cv = [&](bool& c, bool& v) {
+            for (;; i++) {
+                if (at(i) == "const")
+                    c = true;
+                else if (at(i) == "volatile")
+                    v = true;
+                else
+                    return;
+            }
+        };
+
+        cv(isConst, isVolatile);
+        std::string result;
+        if (i < tokens.size() && isBuiltin(at(i))) {
+            std::vector<std::string> words;
+            for (; isBuiltin(at(i)) || at(i) == "const" || at(i) == "volatile";
+                 i++) {
+                if (at(i) == "const")
+                    isConst = true;
+                else if (at(i) == "volatile")
+                    isVolatile = true;
+                else
+                    words.push_back(at(i));
+            }
+            result = builtinName(words);
+        } else if (at(i) == "auto") {
+            result = "auto";
+            i++;
+        } else if (!qualifiedName(tokens, i, true, result))
+            fail();
+        cv(isConst, isVolatile);
+        if (isConst)
+            result += " const";
+        if (isVolatile)
+            result += " volatile";
+
+        while (i < tokens.size()) {
+            auto const& s = at(i++);
+            if (s == "*") {
+                bool c = false, v = false;
+                cv(c, v);
+                result += "*";
+                if (c)
+                    result += " const";
+                if (v)
+                    result += " volatile";
+            } else if ((s == "&" || s == "&&") && i == tokens.size())
+                result += s;
+            else
+                fail();
+        }
+        return result;
+    }
+
+    // A name with scopes, and template arguments if `arguments`. Returns
+    // false if it is something else.
+    bool qualifiedName(Tokens const& tokens, size_t& i, bool arguments,
+                       std::string& name)
+    {
+        while (true) {
+            if (i >= tokens.size() || tokens[i]->kind != ScanToken::Identifier)
+                return false;
+            name += tokens[i++]->spelling;
+            if (i < tokens.size() && tokens[i]->spelling == "<") {
+                if (!arguments)
+                    return false;
+                std::string list;
+                if (!templateArguments(tokens, i, list))
+                    return false;
+                name += "<" + list + ">";
+                // A member of a template would be a dependent type
+                return i >= tokens.size() || tokens[i]->spelling != "::";
+            }
+            if (i >= tokens.size() || tokens[i]->spelling != "::")
+                return true;
+            name += "::";
+            i++;
+        }
+    }
+
+    // From the '<'. cppast keeps the arguments as clang prints them.
+    bool templateArguments(Tokens const& tokens, size_t& i, std::string& list)
+    {
+        i++;
+        while (i < tokens.size()) {
+            auto const& t = *tokens[i];
+            if (isBuiltin(t.spelling)) {
+                std::vector<std::string> words;
+                for (; i < tokens.size() && isBuiltin(tokens[i]->spelling); i++)
+                    words.push_back(tokens[i]->spelling);
+                list += builtinName(words);
+            } else if (t.kind == ScanToken::Literal &&
+                       std::isdigit(static_cast<unsigned char>(t.spelling[0]))) {
+                list += t.spelling;
+                i++;
+            } else {
+                std::string name;
+                if (!qualifiedName(tokens, i, false, name))
+                    return false;
+                list += name;
+            }
+            if (i >= tokens.size())
+                return false;
+            auto const& s = tokens[i++]->spelling;
+            if (s == ">")
+                return true;
+            if (s != ",")
+                return false;
+            list += ", ";
+        }
+        return false;
+    }
+
+    std::string const& path_;
+    std::string_view source_;
+    std::vector<ScanToken> const& tokens_;
+
+    std::vector<cppast::detail::pp_doc_comment> comments_;
+    size_t comment_ = 0;
+    std::unordered_set<std::string> macros_;
+    Guard guard_ = Guard::None;
+    std::string guardMacro_;
+    std::vector<size_t> lineStarts_;
+
+    Tokens code_;
+    size_t pos_ = 0;
+
+    FileModel model_;
+};
+
+ScanToken::Kind kindOf(CXTokenKind kind)
+{
+    switch (kind) {
+    case CXToken_Punctuation:
+        return ScanToken::Punctuation;
+    case CXToken_Keyword:
+        return ScanToken::Keyword;
+    case CXToken_Identifier:
+        return ScanToken::Identifier;
+    case CXToken_Literal:
+        return ScanToken::Literal;
+    case CXToken_Comment:
+        break;
+    }
+    return ScanToken::Comment;
+}
+
+} // namespace
+
+std::optional<FileModel> scanTokens(std::string const& path,
+                                    std::string_view source,
+                                    std::vector<ScanToken> const& tokens,
+                                    std::string* reason)
+{
+    try {
+        return Scanner(path, source, tokens).run();
+    } catch (Unsure const& unsure) {
+        if (reason)
+            *reason = unsure.reason;
+        return std::nullopt;
+    }
+}
+
+CommentScanner::CommentScanner() : index_(clang_createIndex(0, 0)) {}
+
+CommentScanner::~CommentScanner()
+{
+    clang_disposeIndex(index_);
+}
+
+std::optional<FileModel> CommentScanner::scan(std::string const& path)
+{
+    reason_.clear();
+    utils::MappedFile file;
+    if (!file.open(path)) {
+        reason_ = "could not open it";
+        return std::nullopt;
+    }
+
+    // Hide everything from the preprocessor, so libclang reads the file and
+    // does nothing else with it. The tokens come from the text either way.
+    std::string source = "#if 0\n";
+    source += file.view();
+    source += "\n#endif\n";
+
+    CXUnsavedFile unsaved{path.c_str(), source.c_str(),
+                          static_cast<unsigned long>(source.size())};
+    const char* args[] = {"-x", "c++", "-std=c++17"};
+    CXTranslationUnit tu = nullptr;
+    clang_parseTranslationUnit2(
+        index_, path.c_str(), args, 3, &unsaved, 1,
+        CXTranslationUnit_SingleFileParse | CXTranslationUnit_Incomplete, &tu);
+    if (!tu) {
+        reason_ = "libclang could not read it";
+        return std::nullopt;
+    }
+    cppast::detail::cxtranslation_unit unit(tu);
+    cppast::detail::cxtokenizer tokenizer(tu, clang_getFile(tu, path.c_str()));
+
+    std::vector<ScanToken> tokens;
+    for (auto const& token : tokenizer) {
+        unsigned line = 0, column = 0;
+        clang_getSpellingLocation(token.location(), nullptr, &line, &column,
+                                  nullptr);
+        // One line less without the #if 0
+        tokens.push_back(
+            {kindOf(token.kind()), token.c_str(), line - 1, column});
+    }
+    // Nor with the '#' 'if' '0' and '#' 'endif'
+    if (tokens.size() < 5 || tokens.front().line != 0 ||
+        tokens[tokens.size() - 1].spelling != "endif") {
+        reason_ = "libclang did not tokenize it";
+        return std::nullopt;
+    }
+    tokens.erase(tokens.end() - 2, tokens.end());
+    tokens.erase(tokens.begin(), tokens.begin() + 3);
+
+    return scanTokens(path, file.view(), tokens, &reason_);
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "model.h"
+
+#include <clang-c/Index.h>
+
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// A token of a file, as the comment scanner needs it
+struct ScanToken
+{
+    enum Kind
+    {
+        Punctuation,
+        Keyword,
+        Identifier,
+        Literal,
+        Comment
+    };
+    Kind kind;
+    std::string spelling;
+    unsigned line;
+    unsigned column;
+};
+
+// Read the classes of a file, their methods and fields, and the doc
+// comments in front of them, from the tokens of the file alone. `source` is
+// the text the tokens came from.
+// Returns nothing if the file has anything that could change the result
+// without the scanner knowing: conditional compilation, macros, includes it
+// can not find next to the file, or declarations it does not understand.
+// `reason` is then set to what it was.
+std::optional<FileModel> scanTokens(std::string const& path,
+                                    std::string_view source,
+                                    std::vector<ScanToken> const& tokens,
+                                    std::string* reason = nullptr);
+
+// Reads files with `scanTokens()`, without preprocessing or parsing them;
+// libclang only tokenizes. Many times faster than a full parse, for the
+// files it can be sure about. Use one per thread.
+class CommentScanner
+{
+public:
+    CommentScanner();
+    ~CommentScanner();
+
+    CommentScanner(CommentScanner const&) = delete;
+    CommentScanner& operator=(CommentScanner const&) = delete;
+
+    // The model of `path`, or nothing if it has to be parsed instead
+    std::optional<FileModel> scan(std::string const& path);
+
+    // Why the last `scan()` gave up
+    std::string const& reason() const { return reason_; }
+
+private:
+    CXIndex index_;
+    std::string reason_;
+};
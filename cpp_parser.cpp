@@ -0,0 +1,479 @@
+#include "cpp_parser.h"
+#include "comment_scanner.h"
+#include "distill.h"
+#include "parallel_parser.h"
+#include "trace.h"
+
+#include <fmt/format.h>
+
+#include <cppast/code_generator.hpp>  // for generate_code()
+#include <cppast/cpp_entity_kind.hpp> // for the cpp_entity_kind definition
+#include <cppast/cpp_forward_declarable.hpp> // for is_definition()
+#include <cppast/cpp_namespace.hpp>          // for cpp_namespace
+#include <cppast/visitor.hpp>       // for visit()
+
+#include <iostream>
+#include <unordered_set>
+
+#ifdef __unix__
+#    include <limits.h>
+#    include <stdlib.h>
+#endif
+
+std::string resolvePath(const char* path)
+{
+    std::string resolvedPath;
+
+#ifdef __unix__
+    char* resolvedPathRaw = new char[PATH_MAX];
+    char* result = realpath(path, resolvedPathRaw);
+
+    if (result)
+        resolvedPath = resolvedPathRaw;
+
+    delete[] resolvedPathRaw;
+#else
+    resolvedPath = path;
+#endif
+
+    return resolvedPath;
+}
+
+// prints the AST entry of a cpp_entity (base class for all entities),
+// will only print a single line
+void print_entity(std::ostream& out, const cppast::cpp_entity& e)
+{
+    // print name and the kind of the entity
+    if (!e.name().empty())
+        out << e.name();
+    else
+        out << "<anonymous>";
+    out << " (" << cppast::to_string(e.kind()) << ")";
+
+    // print whether or not it is a definition
+    if (cppast::is_definition(e))
+        out << " [definition]";
+
+    // print number of attributes
+    if (!e.attributes().empty())
+        out << " [" << e.attributes().size() << " attribute(s)]";
+
+    if (e.kind() == cppast::cpp_entity_kind::language_linkage_t)
+        // no need to print additional information for language linkages
+        out << '\n';
+    else if (e.kind() == cppast::cpp_entity_kind::namespace_t) {
+        // cast to cpp_namespace
+        auto& ns = static_cast<const cppast::cpp_namespace&>(e);
+        // print whether or not it is inline
+        if (ns.is_inline())
+            out << " [inline]";
+        out << '\n';
+    } else {
+        // print the declaration of the entity
+        // it will only use a single line
+        // derive from code_generator and implement various callbacks for
+        // printing it will print into a std::string
+        class code_generator : public cppast::code_generator
+        {
+            std::string str_; // the result
+            bool was_newline_ =
+                false; // whether or not the last token was a newline
+            // needed for lazily printing them
+
+        public:
+            code_generator(const cppast::cpp_entity& e)
+            {
+                // kickoff code generation here
+                cppast::generate_code(*this, e);
+            }
+
+            // return the result
+            const std::string& str() const noexcept { return str_; }
+
+        private:
+            // called to retrieve the generation options of an entity
+            generation_options
+            do_get_options(const cppast::cpp_entity&,
+                           cppast::cpp_access_specifier_kind) override
+            {
+                // generate declaration only
+                return code_generator::declaration;
+            }
+
+            // no need to handle indentation, as only a single line is used
+            void do_indent() override {}
+            void do_unindent() override {}
+
+            // called when a generic token sequence should be generated
+            // there are specialized callbacks for various token kinds,
+            // to e.g. implement syntax highlighting
+            void do_write_token_seq(cppast::string_view tokens) override
+            {
+                if (was_newline_) {
+                    // lazily append newline as space
+                    str_ += ' ';
+                    was_newline_ = false;
+                }
+                // append tokens
+                str_ += tokens.c_str();
+            }
+
+            // called when a newline should be generated
+            // we're lazy as it will always generate a trailing newline,
+            // we don't want
+            void do_write_newline() override { was_newline_ = true; }
+
+        } generator(e);
+        // print generated code
+        out << ": `" << generator.str() << '`' << '\n';
+    }
+}
+
+CppParser::CppParser(std::string const& project_dir)
+    : project_dir_(project_dir), database_(project_dir),
+      parser_(type_safe::ref(logger_))
+{}
+
+CppParser::~CppParser() = default;
+
+void CppParser::setStreaming(bool streaming, size_t limit)
+{
+    budget_ = streaming ? std::make_unique<MemoryBudget>(limit) : nullptr;
+}
+
+void CppParser::setScanComments(bool scan)
+{
+    scanner_ = scan ? std::make_unique<CommentScanner>() : nullptr;
+}
+
+void CppParser::setCacheDir(std::string const& dir)
+{
+    cache_ = dir.empty() ? nullptr : std::make_unique<ModelCache>(dir);
+    setWanted(wanted_);
+}
+
+bool CppParser::Wanted::matches(std::string const& name) const
+{
+    std::string_view full = name;
+    for (auto end = full.find("::");; end = full.find("::", end + 2)) {
+        auto scope = full.substr(0, end);
+        for (size_t start = 0;;) {
+            auto suffix = std::string(scope.substr(start));
+            if (names.count(suffix) > 0 ||
+                (end == std::string_view::npos && scopes.count(suffix) > 0))
+                return true;
+            auto next = scope.find("::", start);
+            if (next == std::string_view::npos)
+                break;
+            start = next + 2;
+        }
+        if (end == std::string_view::npos)
+            return false;
+    }
+}
+
+void CppParser::Wanted::add(std::string const& name)
+{
+    auto plain = name.compare(0, 2, "::") == 0 ? name.substr(2) : name;
+    names.insert(plain);
+    // `Foo::bar` is a member of `Foo`, which has to be converted to get it
+    for (auto end = plain.find("::"); end != std::string::npos;
+         end = plain.find("::", end + 2))
+        scopes.insert(plain.substr(0, end));
+}
+
+void CppParser::configure(cppast::libclang_compile_config& config) const
+{
+    config.in_process_preprocessing(inProcessPreprocessor_);
+    config.precompiled_preamble(incremental_);
+    for (auto const& header : precompiledHeaders_)
+        config.add_precompiled_header(header);
+    if (wanted_) {
+        config.set_entity_filter([wanted = wanted_](std::string const& name) {
+            return wanted->matches(name);
+        });
+    }
+    if (trace::enabled()) {
+        config.set_phase_observer(
+            [](char const* phase, std::string const& path, bool begin) {
+                if (begin)
+                    trace::begin(phase, path);
+                else
+                    trace::end();
+            });
+    }
+}
+
+void CppParser::setWanted(std::vector<std::string> const& names)
+{
+    if (names.empty()) {
+        setWanted(std::shared_ptr<const Wanted>());
+        return;
+    }
+    auto wanted = std::make_shared<Wanted>();
+    for (auto const& name : names)
+        wanted->add(name);
+    setWanted(std::move(wanted));
+}
+
+void CppParser::setWanted(std::shared_ptr<const Wanted> wanted)
+{
+    wanted_ = std::move(wanted);
+    if (cache_)
+        cache_->setFilter(wanted_ ? std::vector<std::string>(
+                                        wanted_->names.begin(),
+                                        wanted_->names.end())
+                                  : std::vector<std::string>());
+}
+
+cppast::libclang_compile_config
+CppParser::configFor(std::string const& path) const
+{
+    // Headers are not in the database; use the flags of a file that
+    // includes them
+    std::string source = path;
+    std::unordered_set<std::string> seen;
+    std::vector<std::string> todo{path};
+    while (!todo.empty()) {
+        auto file = std::move(todo.back());
+        todo.pop_back();
+        if (!seen.insert(file).second)
+            continue;
+        if (database_.has_config(file)) {
+            source = file;
+            break;
+        }
+        for (auto& includer : graph_.includers(file))
+            todo.push_back(std::move(includer));
+    }
+    cppast::libclang_compile_config config(database_, source);
+    configure(config);
+    return config;
+}
+
+void CppParser::merge(FileModel model)
+{
+    if (model.partial)
+        partial_.insert(model.path);
+    else
+        partial_.erase(model.path);
+
+    std::vector<std::string> includes;
+    for (auto const& include : model.includes)
+        if (!include.system && !include.path.empty())
+            includes.push_back(include.path);
+    graph_.setIncludes(model.path, includes);
+
+    // Replaces what the previous version of the file defined
+    auto path = model.path;
+    std::lock_guard<std::mutex> lock(symbolsMutex_);
+    models_[path] = std::move(model);
+    symbolsDirty_ = true;
+}
+
+std::unique_ptr<cppast::cpp_file>
+CppParser::parseFile(std::string const& path,
+                     cppast::cpp_entity_index const& index)
+{
+    trace::Scope scope("file", path);
+    auto config = configFor(path);
+
+    uint64_t key = 0;
+    bool cacheable = cache_ && cache_->key(path, config, key);
+    if (cacheable) {
+        trace::Scope cacheScope("cache", path);
+        FileModel model;
+        if (cache_->load(key, model)) {
+            merge(std::move(model));
+            return nullptr;
+        }
+    }
+    if (scanner_) {
+        trace::Scope scanScope("scan", path);
+        if (auto model = scanner_->scan(path)) {
+            merge(std::move(*model));
+            return nullptr;
+        }
+        logger_.log("dox", cppast::diagnostic{
+                               "parsing instead of scanning: " +
+                                   scanner_->reason(),
+                               cppast::source_location::make_file(path),
+                               cppast::severity::debug});
+    }
+
+    auto file = parser_.parse(index, path, config);
+    if (parser_.error()) {
+        parser_.reset_error();
+        throw parser_exception("Could not parse " + path);
+    }
+    if (!file)
+        return nullptr; // Already parsed
+    if (verbose_) {
+        std::cerr << path << "\n";
+        cppast::visit(*file, [&](const cppast::cpp_entity& e,
+                                 cppast::visitor_info info) {
+            if (e.kind() == cppast::cpp_entity_kind::class_t) {
+                fmt::print(stderr, "{} : {}\n", e.name(), info.event);
+            }
+            print_entity(std::cerr, e);
+            return true;
+        });
+    }
+    FileModel model;
+    {
+        trace::Scope distillScope("distill", path);
+        model = distill(*file);
+    }
+    model.partial = wanted_ != nullptr;
+    if (cacheable) {
+        trace::Scope storeScope("store", path);
+        cache_->store(key, model);
+    }
+    merge(std::move(model));
+    return file;
+}
+
+void CppParser::load(std::string const& source_file)
+{
+    auto resolvedPath = resolvePath(source_file.c_str());
+    if (models_.count(resolvedPath) > 0)
+        return;
+    if (frozen_)
+        throw parser_exception(source_file + " was not parsed up front");
+    if (budget_) {
+        // The index goes with the AST it points into
+        MemoryBudget::Scope room(*budget_);
+        cppast::cpp_entity_index index;
+        parseFile(resolvedPath, index);
+        return;
+    }
+    if (auto file = parseFile(resolvedPath, index_))
+        files_.push_back(std::move(file));
+}
+
+std::vector<std::string>
+CppParser::update(std::vector<std::string> const& changed)
+{
+    if (frozen_)
+        throw parser_exception("Can not parse again after freeze()");
+    std::vector<std::string> updated;
+    for (auto const& path : graph_.affected(changed)) {
+        if (models_.count(path) == 0)
+            continue; // A header we only know as an include
+        try {
+            // The shared index still has the entities of the old version,
+            // so parse into a fresh one. Only the model is kept.
+            cppast::cpp_entity_index index;
+            parseFile(path, index);
+            updated.push_back(path);
+        } catch (std::exception const& e) {
+            fmt::print(stderr, "{}: {}\n", path, e.what());
+        }
+    }
+    return updated;
+}
+
+Class const* CppParser::resolveClass(std::string const& name,
+                                     std::string* file)
+{
+    if (auto* c = findClass(name, file))
+        return c;
+    if (frozen_ || !wanted_ || partial_.empty())
+        return nullptr;
+    // Converted already if it were there; do not parse everything again
+    // for a name that does not exist
+    auto plain = name.compare(0, 2, "::") == 0 ? name.substr(2) : name;
+    if (wanted_->names.count(plain) > 0)
+        return nullptr;
+
+    // Ask for it too, and parse what was skipped again
+    auto wanted = std::make_shared<Wanted>(*wanted_);
+    wanted->add(name);
+    setWanted(std::move(wanted));
+    update({partial_.begin(), partial_.end()});
+    return findClass(name, file);
+}
+
+SymbolIndex const& CppParser::symbols() const
+{
+    if (frozen_)
+        return symbols_;
+    std::lock_guard<std::mutex> lock(symbolsMutex_);
+    if (symbolsDirty_) {
+        trace::Scope scope("symbols");
+        symbols_.build(models_);
+        symbolsDirty_ = false;
+    }
+    return symbols_;
+}
+
+void CppParser::freeze()
+{
+    symbols();
+    index_.freeze();
+    frozen_ = true;
+}
+
+Class const* CppParser::findClass(std::string const& name,
+                                  std::string* file) const
+{
+    using Kind = SymbolIndex::Kind;
+    auto const& index = symbols();
+    SymbolIndex::Symbol const* found = nullptr;
+    for (auto const& s : index.find(name))
+        if (!found && s.kind == Kind::Class)
+            found = &s;
+    if (!found) {
+        for (auto const* s : index.named(name))
+            if (!found && s->kind == Kind::Class)
+                found = s;
+    }
+    if (!found)
+        return nullptr;
+    if (file)
+        *file = std::string(found->file);
+    return found->owner;
+}
+
+void CppParser::loadProject(unsigned threads)
+{
+    ParallelParser parser(
+        database_, index_, logger_, cache_.get(), threads,
+        [this](cppast::libclang_compile_config& c) { configure(c); },
+        scanner_ != nullptr, budget_.get());
+    cppast::detail::for_each_file(
+        database_, &parser, [](void* data, std::string file) {
+            static_cast<ParallelParser*>(data)->parse(file);
+        });
+    collect(parser);
+}
+
+void CppParser::loadFiles(std::vector<std::string> const& source_files,
+                          unsigned threads)
+{
+    ParallelParser parser(
+        database_, index_, logger_, cache_.get(), threads,
+        [this](cppast::libclang_compile_config& c) { configure(c); },
+        scanner_ != nullptr, budget_.get());
+    for (auto const& file : source_files) {
+        auto path = resolvePath(file.c_str());
+        // The rest is left for load(), which can borrow flags from includers
+        if (!path.empty() && models_.count(path) == 0 &&
+            database_.has_config(path))
+            parser.parse(path);
+    }
+    collect(parser);
+}
+
+void CppParser::collect(ParallelParser& parser)
+{
+    parser.wait();
+    for (auto& model : parser.takeModels())
+        merge(std::move(model));
+    for (auto& file : parser.takeFiles())
+        files_.push_back(std::move(file));
+    // Keep what we got; a few broken TUs should not stop the documentation
+    if (parser.error())
+        fmt::print(stderr, "Warning: Some files in {} could not be parsed\n",
+                   project_dir_);
+}
@@ -0,0 +1,179 @@
+#pragma once
+
+#include "dependency_graph.h"
+#include "memory_budget.h"
+#include "model.h"
+#include "model_cache.h"
+#include "symbol_index.h"
+
+#include <cppast/libclang_parser.hpp>
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+class CommentScanner;
+class ParallelParser;
+
+struct parser_exception : public std::exception
+{
+    parser_exception(std::string const& msg) : message(msg) {}
+    const char* what() const noexcept override { return message.c_str(); }
+    std::string message;
+};
+
+std::string resolvePath(const char* path);
+
+class CppParser
+{
+    std::string project_dir_;
+    cppast::libclang_compilation_database database_;
+    cppast::stderr_diagnostic_logger logger_;
+    cppast::libclang_parser parser_;
+    std::unique_ptr<ModelCache> cache_;
+    bool verbose_ = false;
+    bool inProcessPreprocessor_ = false;
+    bool incremental_ = false;
+    std::vector<std::string> precompiledHeaders_;
+    // Set if files are scanned for comments before they are parsed
+    std::unique_ptr<CommentScanner> scanner_;
+    // Set if only models are kept; see `setStreaming()`
+    std::unique_ptr<MemoryBudget> budget_;
+
+    // Shared by all parsed files so cross references resolve between them.
+    // Empty when streaming; models then refer to each other by qualified
+    // name, which `symbols()` resolves, so they need no ids of their own.
+    cppast::cpp_entity_index index_;
+    std::vector<std::unique_ptr<cppast::cpp_file>> files_;
+
+    // Every parsed file
+    std::unordered_map<std::string, FileModel> models_;
+    DependencyGraph graph_;
+
+    // Names the template refers to, and every scope they are in
+    struct Wanted
+    {
+        std::unordered_set<std::string> names;
+        std::unordered_set<std::string> scopes;
+
+        void add(std::string const& name);
+        // Whether `name`, or a scope it is in, is one of `names`, or `name`
+        // is one of `scopes`; with or without leading scopes
+        bool matches(std::string const& name) const;
+    };
+    // The only entities converted, unless null. Shared with the entity
+    // filters of running parsers.
+    std::shared_ptr<const Wanted> wanted_;
+    // Files whose models only have what was wanted
+    std::unordered_set<std::string> partial_;
+
+    // Built from `models_` when it is first needed after a change
+    mutable SymbolIndex symbols_;
+    mutable bool symbolsDirty_ = true;
+    mutable std::mutex symbolsMutex_;
+    // Nothing is parsed any more, so lookups need no lock
+    bool frozen_ = false;
+
+    void setWanted(std::shared_ptr<const Wanted> wanted);
+    void merge(FileModel model);
+    void collect(ParallelParser& parser);
+    void configure(cppast::libclang_compile_config& config) const;
+    cppast::libclang_compile_config configFor(std::string const& path) const;
+    std::unique_ptr<cppast::cpp_file>
+    parseFile(std::string const& path, cppast::cpp_entity_index const& index);
+
+public:
+    CppParser(std::string const& project_dir);
+    ~CppParser();
+
+    // Keep distilled models in `dir` between runs. Empty disables the cache.
+    void setCacheDir(std::string const& dir);
+
+    // Dump the AST of every parsed file to stderr
+    void setVerbose(bool verbose)
+    {
+        verbose_ = verbose;
+        logger_.set_verbose(verbose);
+    }
+
+    // Keep translation units in memory so changed files are reparsed
+    // quickly by `update()`
+    void setIncremental(bool incremental) { incremental_ = incremental; }
+
+    // Preprocess inside libclang, instead of with a clang process per file.
+    // Faster, but misses entities that are generated by macros; cppast
+    // warns about every one it skips.
+    void setInProcessPreprocessor(bool inProcess)
+    {
+        inProcessPreprocessor_ = inProcess;
+    }
+
+    // Read files with a `CommentScanner` first, and only parse the ones it
+    // gives up on
+    void setScanComments(bool scan);
+
+    // Keep only the model of each file, and free its AST and translation
+    // unit as soon as it is distilled. With a `limit` (in bytes), parsing of
+    // more files is held back while the process uses more than that.
+    void setStreaming(bool streaming, size_t limit = 0);
+
+    // Precompile `header` once and use it for every parsed file
+    void addPrecompiledHeader(std::string const& header)
+    {
+        precompiledHeaders_.push_back(header);
+    }
+
+    // Only convert the entities these names refer to, and what is declared
+    // inside of them. Names may leave out leading scopes. Everything is
+    // converted if `names` is empty.
+    void setWanted(std::vector<std::string> const& names);
+
+    // Parse a single source file, unless it has been parsed already
+    void load(std::string const& source_file);
+
+    // Parse every translation unit in the compilation database, using
+    // `threads` workers (0 means one per core)
+    void loadProject(unsigned threads = 0);
+
+    // Parse these source files in parallel, skipping those that are parsed
+    // already or are not in the compilation database
+    void loadFiles(std::vector<std::string> const& source_files,
+                   unsigned threads = 0);
+
+    // Parse the changed files again, along with every file that includes
+    // them. Returns the files that were parsed.
+    std::vector<std::string> update(std::vector<std::string> const& changed);
+
+    // Every parsed file and the local headers they include
+    std::vector<std::string> files() const { return graph_.files(); }
+
+    // Find a class by qualified or plain name. `file` is set to the file
+    // that defines it.
+    Class const* findClass(std::string const& name,
+                           std::string* file = nullptr) const;
+
+    // Like `findClass()`, but if the class was skipped because it was not
+    // wanted, parse the skipped files again to find it. Names that were
+    // wanted all along are not looked for again.
+    Class const* resolveClass(std::string const& name,
+                              std::string* file = nullptr);
+
+    // Every class, method and field parsed so far. Invalidated by the next
+    // `load()` or `update()`.
+    SymbolIndex const& symbols() const;
+
+    // Stop parsing, so renderers on several threads can share the parser.
+    // Afterwards `load()` throws for files that were not parsed already,
+    // `resolveClass()` is `findClass()`, and `update()` must not be called.
+    void freeze();
+    bool frozen() const { return frozen_; }
+
+    void test1(size_t abc) {}
+
+    void test2(std::thread const& cde) {}
+    void test3(std::vector<int> const& fgh) {}
+};
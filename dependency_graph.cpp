@@ -0,0 +1,48 @@
+#include "dependency_graph.h"
+
+void DependencyGraph::setIncludes(std::string const& file,
+                                  std::vector<std::string> const& includes)
+{
+    auto& current = includes_[file];
+    for (auto const& include : current)
+        includers_[include].erase(file);
+    current = includes;
+    for (auto const& include : current)
+        includers_[include].insert(file);
+}
+
+std::vector<std::string>
+DependencyGraph::includers(std::string const& file) const
+{
+    auto it = includers_.find(file);
+    if (it == includers_.end())
+        return {};
+    return {it->second.begin(), it->second.end()};
+}
+
+std::unordered_set<std::string>
+DependencyGraph::affected(std::vector<std::string> const& changed) const
+{
+    std::unordered_set<std::string> result;
+    std::vector<std::string> todo = changed;
+    while (!todo.empty()) {
+        auto file = std::move(todo.back());
+        todo.pop_back();
+        if (!result.insert(file).second)
+            continue;
+        auto it = includers_.find(file);
+        if (it != includers_.end())
+            todo.insert(todo.end(), it->second.begin(), it->second.end());
+    }
+    return result;
+}
+
+std::vector<std::string> DependencyGraph::files() const
+{
+    std::unordered_set<std::string> all;
+    for (auto const& entry : includes_) {
+        all.insert(entry.first);
+        all.insert(entry.second.begin(), entry.second.end());
+    }
+    return {all.begin(), all.end()};
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Records which files include which, so that a change to a header can be
+// traced to every file that has to be parsed again
+class DependencyGraph
+{
+public:
+    // Replace the includes recorded for `file`
+    void setIncludes(std::string const& file,
+                     std::vector<std::string> const& includes);
+
+    // Files that directly include `file`
+    std::vector<std::string> includers(std::string const& file) const;
+
+    // The changed files, and every file that includes one of them,
+    // directly or not
+    std::unordered_set<std::string>
+    affected(std::vector<std::string> const& changed) const;
+
+    // Every file that is part of the graph
+    std::vector<std::string> files() const;
+
+private:
+    std::unordered_map<std::string, std::vector<std::string>> includes_;
+    std::unordered_map<std::string, std::unordered_set<std::string>>
+        includers_;
+};
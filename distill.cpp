@@ -0,0 +1,114 @@
+#include "distill.h"
+
+#include <cppast/cpp_class.hpp>
+#include <cppast/cpp_entity_kind.hpp>
+#include <cppast/cpp_forward_declarable.hpp> // for is_definition()
+#include <cppast/cpp_member_function.hpp>
+#include <cppast/cpp_member_variable.hpp>
+#include <cppast/cpp_preprocessor.hpp>
+#include <cppast/visitor.hpp>
+
+namespace {
+
+std::string join(std::vector<std::string> const& scope)
+{
+    std::string result;
+    for (auto const& s : scope) {
+        if (!result.empty())
+            result += "::";
+        result += s;
+    }
+    return result;
+}
+
+std::string docOf(cppast::cpp_entity const& e)
+{
+    return e.comment() ? e.comment().value() : std::string();
+}
+
+Method toMethod(cppast::cpp_function_base const& f)
+{
+    Method method;
+    method.name = f.name();
+    method.doc = docOf(f);
+    for (auto const& p : f.parameters())
+        method.params.push_back(
+            {p.name(), cppast::to_string(p.type()), docOf(p)});
+    return method;
+}
+
+} // namespace
+
+FileModel distill(cppast::cpp_file const& file)
+{
+    FileModel model;
+    model.path = file.name();
+    for (auto const& dependency : file.dependencies())
+        model.dependencies.push_back(dependency);
+
+    std::vector<std::string> scope;
+    // Index into model.classes of the classes we are inside, -1 for
+    // declarations we are not interested in
+    std::vector<int> current;
+    auto currentClass = [&]() -> Class* {
+        if (current.empty() || current.back() < 0)
+            return nullptr;
+        return &model.classes[current.back()];
+    };
+
+    cppast::visit(file, [&](const cppast::cpp_entity& e,
+                            cppast::visitor_info info) {
+        bool enter = info.event ==
+                     cppast::visitor_info::container_entity_enter;
+        switch (e.kind()) {
+        case cppast::cpp_entity_kind::include_directive_t: {
+            auto const& include =
+                static_cast<cppast::cpp_include_directive const&>(e);
+            model.includes.push_back(
+                {include.full_path(),
+                 include.include_kind() == cppast::cpp_include_kind::system});
+            break;
+        }
+        case cppast::cpp_entity_kind::namespace_t:
+            if (enter)
+                scope.push_back(e.name());
+            else
+                scope.pop_back();
+            break;
+        case cppast::cpp_entity_kind::class_t:
+            if (enter) {
+                int index = -1;
+                if (cppast::is_definition(e)) {
+                    index = static_cast<int>(model.classes.size());
+                    model.classes.emplace_back(join(scope), e.name());
+                    model.classes.back().doc = docOf(e);
+                }
+                current.push_back(index);
+                scope.push_back(e.name());
+            } else {
+                current.pop_back();
+                scope.pop_back();
+            }
+            break;
+        case cppast::cpp_entity_kind::member_function_t:
+        case cppast::cpp_entity_kind::conversion_op_t:
+        case cppast::cpp_entity_kind::constructor_t:
+            if (auto* c = currentClass())
+                c->methods.push_back(toMethod(
+                    static_cast<cppast::cpp_function_base const&>(e)));
+            break;
+        case cppast::cpp_entity_kind::member_variable_t:
+            if (auto* c = currentClass()) {
+                auto const& var =
+                    static_cast<cppast::cpp_member_variable const&>(e);
+                c->fields.push_back(
+                    {var.name(), cppast::to_string(var.type()), docOf(var)});
+            }
+            break;
+        default:
+            break;
+        }
+        return true;
+    });
+    return model;
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+#include "model.h"
+
+#include <cppast/cpp_file.hpp>
+
+// Reduce a parsed file to the documentation model
+FileModel distill(cppast::cpp_file const& file);
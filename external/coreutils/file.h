@@ -138,7 +138,7 @@ public:
 
     std::string readLine() const
     {
-        std::vector<char> lineTarget(10);
+        std::vector<char> lineTarget(128);
         size_t endp = 0;
         while (true) {
             char* ptr = fgets(&lineTarget[endp], (int)(lineTarget.size() - endp), fp);
@@ -162,16 +162,18 @@ public:
             if (found || eof()) {
                 break;
             }
-            // If LF not found we need to read more
+            // If LF not found we need to read more; grow geometrically so
+            // long lines do not take quadratic time
             endp += len;
-            lineTarget.resize(lineTarget.size() + 10);
+            lineTarget.resize(lineTarget.size() * 2);
         }
         return std::string(&lineTarget[0]);
     }
 
     void writeln(std::string const& line) const noexcept
     {
-        fputs((line + "\n").c_str(), fp);
+        fwrite(line.c_str(), 1, line.length(), fp);
+        fputc('\n', fp);
     }
 
     void writeString(std::string const& line) const noexcept
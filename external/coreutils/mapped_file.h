@@ -0,0 +1,164 @@
+#pragma once
+
+#include "file.h"
+#include "split.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <string_view>
+
+#ifndef _WIN32
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#endif
+
+namespace utils {
+
+// Read only view of a whole file. Regular files are memory mapped; pipes,
+// stdin and anything else that can not be mapped are read into memory
+// instead, so there is no second code path for callers.
+class MappedFile
+{
+public:
+    MappedFile() = default;
+
+    // Throws io_exception if the file can not be opened
+    explicit MappedFile(std::string const& name)
+    {
+        if (!open(name))
+            throw io_exception("Could not open " + name);
+    }
+
+    // Returns false if the file can not be opened
+    bool open(std::string const& name)
+    {
+        *this = MappedFile();
+#ifdef _WIN32
+        File f;
+        if (!f.open(name.c_str(), File::Read))
+            return false;
+        readAll(f);
+#else
+        int fd = ::open(name.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            return false;
+        try {
+            mapOrRead(fd);
+        } catch (...) {
+            ::close(fd);
+            throw;
+        }
+        ::close(fd);
+#endif
+        return true;
+    }
+
+    // Everything that is left on stdin
+    static MappedFile stdIn()
+    {
+        MappedFile m;
+#ifdef _WIN32
+        m.readAll(stdin);
+#else
+        m.mapOrRead(fileno(stdin));
+#endif
+        return m;
+    }
+
+    MappedFile(MappedFile&& other) noexcept { *this = std::move(other); }
+    MappedFile& operator=(MappedFile&& other) noexcept
+    {
+        if (this != &other) {
+            unmap();
+            data_ = other.data_;
+            size_ = other.size_;
+            mapped_ = other.mapped_;
+            contents_ = std::move(other.contents_);
+            if (!mapped_)
+                data_ = contents_.data();
+            other.data_ = nullptr;
+            other.size_ = 0;
+            other.mapped_ = false;
+        }
+        return *this;
+    }
+    MappedFile(MappedFile const&) = delete;
+    MappedFile& operator=(MappedFile const&) = delete;
+
+    ~MappedFile() { unmap(); }
+
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    std::string_view view() const { return {data_, size_}; }
+
+    // Whether the contents are mapped, rather than read into memory
+    bool mapped() const { return mapped_; }
+
+    // Iterate over the lines, without copying them
+    Lines lines() const { return Lines(view()); }
+
+private:
+    void unmap()
+    {
+#ifndef _WIN32
+        if (mapped_)
+            ::munmap(const_cast<char*>(data_), size_);
+#endif
+        mapped_ = false;
+    }
+
+    void readAll(FILE* fp)
+    {
+        char buffer[64 * 1024];
+        size_t n;
+        while ((n = fread(buffer, 1, sizeof(buffer), fp)) > 0)
+            contents_.append(buffer, n);
+        data_ = contents_.data();
+        size_ = contents_.size();
+    }
+
+#ifndef _WIN32
+    void mapOrRead(int fd)
+    {
+        struct stat sb;
+        // Files larger than the address space can not be mapped (or read)
+        if (::fstat(fd, &sb) == 0 && S_ISREG(sb.st_mode) && sb.st_size > 0 &&
+            static_cast<unsigned long long>(sb.st_size) <= SIZE_MAX) {
+            auto size = static_cast<size_t>(sb.st_size);
+            void* p = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED) {
+                // Mostly read front to back, once
+                ::madvise(p, size, MADV_SEQUENTIAL);
+                data_ = static_cast<const char*>(p);
+                size_ = size;
+                mapped_ = true;
+                return;
+            }
+        }
+        // Pipes, and files like those in /proc that claim to be empty
+        char buffer[64 * 1024];
+        ssize_t n;
+        while ((n = ::read(fd, buffer, sizeof(buffer))) != 0) {
+            if (n < 0) {
+                if (errno == EINTR)
+                    continue;
+                throw io_exception("Could not read file");
+            }
+            contents_.append(buffer, static_cast<size_t>(n));
+        }
+        data_ = contents_.data();
+        size_ = contents_.size();
+    }
+#endif
+
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    bool mapped_ = false;
+    std::string contents_;
+};
+
+} // namespace utils
@@ -0,0 +1,82 @@
+#include "mapped_file.h"
+#include "output_buffer.h"
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include <cstdio>
+
+using namespace utils;
+
+TEST_CASE("Map file", "[mapped_file]")
+{
+    File{"dummy", File::Write}.writeString("first\r\nsecond\n\nlast");
+
+    MappedFile m{"dummy"};
+    REQUIRE(m.mapped());
+    REQUIRE(m.view() == "first\r\nsecond\n\nlast");
+
+    std::vector<std::string_view> lines;
+    for (auto line : m.lines())
+        lines.push_back(line);
+    REQUIRE(lines == std::vector<std::string_view>{"first", "second", "", "last"});
+
+    MappedFile moved = std::move(m);
+    REQUIRE(moved.size() == 19);
+    REQUIRE(m.empty());
+
+    remove("dummy");
+}
+
+TEST_CASE("Empty and missing files", "[mapped_file]")
+{
+    File{"dummy", File::Write}.writeString("");
+    MappedFile m{"dummy"};
+    REQUIRE(m.empty());
+    REQUIRE(m.lines().begin() == m.lines().end());
+    remove("dummy");
+
+    REQUIRE(!m.open("does/not/exist"));
+    REQUIRE_THROWS_AS(MappedFile{"does/not/exist"}, io_exception);
+}
+
+TEST_CASE("Read pipe", "[mapped_file]")
+{
+    int fds[2];
+    REQUIRE(pipe(fds) == 0);
+    REQUIRE(write(fds[1], "piped", 5) == 5);
+    close(fds[1]);
+
+    // Can not be mapped, so it is read instead
+    MappedFile m{"/dev/fd/" + std::to_string(fds[0])};
+    close(fds[0]);
+    REQUIRE(!m.mapped());
+    REQUIRE(m.view() == "piped");
+}
+
+TEST_CASE("Split views", "[split]")
+{
+    std::string text = "a::b::::c";
+    std::vector<std::string_view> parts = StringViewSplit(text, "::");
+    REQUIRE(parts == std::vector<std::string_view>{"a", "b", "", "c"});
+    // Into the text, not copies of it
+    REQUIRE(parts[2].data() == text.data() + 6);
+
+    std::vector<std::string_view> none = StringViewSplit("", ",");
+    REQUIRE(none == std::vector<std::string_view>{""});
+    std::vector<std::string_view> trailing = StringViewSplit("x,", ",");
+    REQUIRE(trailing == std::vector<std::string_view>{"x", ""});
+}
+
+TEST_CASE("Buffered output", "[output_buffer]")
+{
+    {
+        OutputBuffer out{"dummy", 4};
+        out.write("ab");
+        out.write("cd");
+        out.write("long block");
+        out.writeln("!");
+        REQUIRE(out.written() == 16);
+    }
+    REQUIRE(MappedFile{"dummy"}.view() == "abcdlong block!\n");
+    remove("dummy");
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "file.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace utils {
+
+// Collects output and writes it in large blocks, instead of one fwrite()
+// per call. Memory use is bounded by the buffer size, however much is
+// written.
+class OutputBuffer
+{
+public:
+    static constexpr size_t defaultCapacity = 1 << 20;
+
+    // Write to `out`, which is not closed
+    explicit OutputBuffer(FILE* out, size_t capacity = defaultCapacity)
+        : file_(out), buffer_(new char[capacity]), capacity_(capacity)
+    {}
+
+    // Create (or truncate) `fileName` and write to it
+    explicit OutputBuffer(std::string const& fileName,
+                          size_t capacity = defaultCapacity)
+        : file_(fopen(fileName.c_str(), "wb")), owned_(true),
+          buffer_(new char[capacity]), capacity_(capacity)
+    {
+        if (!file_)
+            throw io_exception("Could not create " + fileName + ": " +
+                               strerror(errno));
+        // We already write in large blocks
+        setvbuf(file_, nullptr, _IONBF, 0);
+    }
+
+    ~OutputBuffer()
+    {
+        try {
+            flush();
+        } catch (io_exception&) {
+            // Can not report it from here; call flush() to find out
+        }
+        if (owned_)
+            fclose(file_);
+    }
+
+    OutputBuffer(OutputBuffer const&) = delete;
+    OutputBuffer& operator=(OutputBuffer const&) = delete;
+
+    void write(std::string_view text)
+    {
+        written_ += text.size();
+        if (used_ + text.size() > capacity_) {
+            flush();
+            // Large blocks go straight out
+            if (text.size() >= capacity_) {
+                writeOut(text.data(), text.size());
+                return;
+            }
+        }
+        memcpy(buffer_.get() + used_, text.data(), text.size());
+        used_ += text.size();
+    }
+
+    void writeln(std::string_view line)
+    {
+        write(line);
+        write("\n");
+    }
+
+    void flush()
+    {
+        if (used_ > 0) {
+            auto size = used_;
+            used_ = 0;
+            writeOut(buffer_.get(), size);
+        }
+        fflush(file_);
+    }
+
+    // Total number of bytes written so far
+    size_t written() const { return written_; }
+
+private:
+    void writeOut(const char* data, size_t size)
+    {
+        if (fwrite(data, 1, size, file_) != size)
+            throw io_exception(std::string("Write failed: ") +
+                               strerror(errno));
+    }
+
+    FILE* file_;
+    bool owned_ = false;
+    std::unique_ptr<char[]> buffer_;
+    size_t capacity_;
+    size_t used_ = 0;
+    size_t written_ = 0;
+};
+
+} // namespace utils
@@ -2,7 +2,9 @@
 
 #include <algorithm>
 #include <cstring>
+#include <iterator>
 #include <string>
+#include <string_view>
 #include <tuple>
 #include <utility>
 #include <vector>
@@ -78,6 +80,156 @@ public:
     }
 };
 
+// Like StringSplit, but the parts are views into `text`, which must outlive
+// them. Nothing is copied, and the parts are found as they are iterated.
+class StringViewSplit
+{
+    std::string_view text;
+    std::string_view delim;
+
+public:
+    StringViewSplit(std::string_view text, std::string_view delim)
+        : text(text), delim(delim)
+    {}
+
+    class iterator
+    {
+        std::string_view rest;
+        std::string_view delim;
+        std::string_view part;
+        // `part` is the last one
+        bool last = false;
+        bool done = true;
+
+        void next()
+        {
+            auto pos = delim.empty() ? std::string_view::npos : rest.find(delim);
+            last = pos == std::string_view::npos;
+            part = rest.substr(0, pos);
+            if (!last)
+                rest = rest.substr(pos + delim.size());
+        }
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = std::string_view;
+        using difference_type = std::ptrdiff_t;
+        using pointer = std::string_view const*;
+        using reference = std::string_view const&;
+
+        iterator() = default;
+        iterator(std::string_view text, std::string_view delim)
+            : rest(text), delim(delim), done(false)
+        {
+            next();
+        }
+
+        std::string_view const& operator*() const { return part; }
+        std::string_view const* operator->() const { return &part; }
+        iterator& operator++()
+        {
+            if (last)
+                done = true;
+            else
+                next();
+            return *this;
+        }
+        iterator operator++(int)
+        {
+            auto it = *this;
+            ++*this;
+            return it;
+        }
+        bool operator==(iterator const& other) const
+        {
+            return done == other.done &&
+                   (done || part.data() == other.part.data());
+        }
+        bool operator!=(iterator const& other) const
+        {
+            return !(*this == other);
+        }
+    };
+
+    iterator begin() const { return iterator(text, delim); }
+    iterator end() const { return iterator(); }
+
+    operator std::vector<std::string_view>() const
+    {
+        return std::vector<std::string_view>(begin(), end());
+    }
+};
+
+// The lines of `text` as views into it, without the line endings ("\n" or
+// "\r\n"). A final line ending does not start another, empty, line.
+class Lines
+{
+    std::string_view text;
+
+public:
+    explicit Lines(std::string_view text) : text(text) {}
+
+    class iterator
+    {
+        std::string_view rest;
+        std::string_view line;
+        bool done = true;
+
+        void next()
+        {
+            if (rest.empty()) {
+                done = true;
+                return;
+            }
+            auto pos = rest.find('\n');
+            line = rest.substr(0, pos);
+            rest = pos == std::string_view::npos ? std::string_view{}
+                                                 : rest.substr(pos + 1);
+            if (!line.empty() && line.back() == '\r')
+                line.remove_suffix(1);
+        }
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = std::string_view;
+        using difference_type = std::ptrdiff_t;
+        using pointer = std::string_view const*;
+        using reference = std::string_view const&;
+
+        iterator() = default;
+        explicit iterator(std::string_view text) : rest(text), done(false)
+        {
+            next();
+        }
+
+        std::string_view const& operator*() const { return line; }
+        std::string_view const* operator->() const { return &line; }
+        iterator& operator++()
+        {
+            next();
+            return *this;
+        }
+        iterator operator++(int)
+        {
+            auto it = *this;
+            next();
+            return it;
+        }
+        bool operator==(iterator const& other) const
+        {
+            return done == other.done &&
+                   (done || rest.data() == other.rest.data());
+        }
+        bool operator!=(iterator const& other) const
+        {
+            return !(*this == other);
+        }
+    };
+
+    iterator begin() const { return iterator(text); }
+    iterator end() const { return iterator(); }
+};
+
 template <typename T, typename S>
 inline StringSplit split(T&& s, S const& delim, int minSplits = -1)
 {
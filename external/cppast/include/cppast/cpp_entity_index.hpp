@@ -5,6 +5,7 @@
 #ifndef CPPAST_CPP_ENTITY_INDEX_HPP_INCLUDED
 #define CPPAST_CPP_ENTITY_INDEX_HPP_INCLUDED
 
+#include <atomic>
 #include <cstdint>
 #include <mutex>
 #include <string>
@@ -58,6 +59,9 @@ inline namespace literals
 /// An index of all [cppast::cpp_entity]() objects created.
 ///
 /// It maps [cppast::cpp_entity_id]() to references to the [cppast::cpp_entity]() objects.
+/// The entries are spread over independently locked shards,
+/// so threads registering different entities rarely wait for each other.
+/// Once everything is registered, [*freeze]() the index to make lookups lock free.
 class cpp_entity_index
 {
 public:
@@ -73,6 +77,7 @@ public:
     /// \throws duplicate_defintion_error if the entity has been registered as definition before.
     /// \requires The entity must live as long as the index lives,
     /// and it must not be a namespace.
+    /// The index must not be frozen.
     /// \notes This operation is thread safe.
     void register_definition(cpp_entity_id                           id,
                              type_safe::object_ref<const cpp_entity> entity) const;
@@ -81,6 +86,7 @@ public:
     /// \returns `true` if the file was not registered before.
     /// If it returns `false`, the file was registered before and nothing was changed.
     /// \requires The entity must live as long as the index lives.
+    /// The index must not be frozen.
     /// \notes This operation is thread safe.
     bool register_file(cpp_entity_id id, type_safe::object_ref<const cpp_file> file) const;
 
@@ -88,11 +94,13 @@ public:
     /// Only the first declaration will be registered.
     /// \requires The entity must live as long as the index lives.
     /// \requires The entity must be forward declarable.
+    /// The index must not be frozen.
     /// \notes This operation is thread safe.
     void register_forward_declaration(cpp_entity_id                           id,
                                       type_safe::object_ref<const cpp_entity> entity) const;
 
     /// \effects Registers a new [cppast::cpp_namespace]().
+    /// \requires The index must not be frozen.
     /// \notes The namespace object must live as long as the index lives.
     /// \notes This operation is thread safe.
     void register_namespace(cpp_entity_id id, type_safe::object_ref<const cpp_namespace> ns) const;
@@ -115,6 +123,18 @@ public:
     auto lookup_namespace(const cpp_entity_id& id) const noexcept
         -> type_safe::array_ref<type_safe::object_ref<const cpp_namespace>>;
 
+    /// \effects Publishes the registered entities and forbids further registration.
+    /// Afterwards the lookup functions no longer lock and never wait.
+    /// \notes This operation is thread safe,
+    /// registrations that are still running will be finished first.
+    void freeze() noexcept;
+
+    /// \returns Whether or not [*freeze]() has been called.
+    bool is_frozen() const noexcept
+    {
+        return frozen_.load(std::memory_order_acquire);
+    }
+
 private:
     struct hash
     {
@@ -134,11 +154,30 @@ private:
         {}
     };
 
-    mutable std::mutex                                     mutex_;
-    mutable std::unordered_map<cpp_entity_id, value, hash> map_;
-    mutable std::unordered_map<cpp_entity_id,
-                               std::vector<type_safe::object_ref<const cpp_namespace>>, hash>
-        ns_;
+    struct shard
+    {
+        std::mutex                                     mutex;
+        std::unordered_map<cpp_entity_id, value, hash> map;
+        std::unordered_map<cpp_entity_id,
+                           std::vector<type_safe::object_ref<const cpp_namespace>>, hash>
+            ns;
+        // keeps the mutexes of neighbouring shards out of the same cache line
+        char padding[64];
+    };
+
+    // the top bits select the shard, the maps use the bottom ones for their buckets
+    static constexpr unsigned    shard_bits  = 6;
+    static constexpr std::size_t shard_count = std::size_t(1) << shard_bits;
+
+    shard& get_shard(const cpp_entity_id& id) const noexcept
+    {
+        auto hash = static_cast<detail::hash_type>(id);
+        return shards_[std::size_t(hash >> (sizeof(detail::hash_type) * 8u - shard_bits))
+                       & (shard_count - 1u)];
+    }
+
+    mutable shard     shards_[shard_count];
+    std::atomic<bool> frozen_{false};
 };
 } // namespace cppast
 
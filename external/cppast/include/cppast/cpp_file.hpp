@@ -49,6 +49,12 @@ public:
             file_->comments_.push_back(std::move(comment));
         }
 
+        /// \effects Adds a file that is included, directly or indirectly.
+        void add_dependency(std::string path)
+        {
+            file_->dependencies_.push_back(std::move(path));
+        }
+
         /// \returns The not yet finished file.
         cpp_file& get() noexcept
         {
@@ -74,6 +80,15 @@ public:
         return type_safe::ref(comments_.data(), comments_.size());
     }
 
+    /// \returns The full paths of every file that was included while parsing the file,
+    /// directly or indirectly.
+    /// \notes This is what the result depends on besides the file itself,
+    /// so it can be used to tell whether a parse is still up to date.
+    type_safe::array_ref<const std::string> dependencies() const noexcept
+    {
+        return type_safe::ref(dependencies_.data(), dependencies_.size());
+    }
+
 private:
     cpp_file(std::string name) : cpp_entity(std::move(name)) {}
 
@@ -81,6 +96,7 @@ private:
     cpp_entity_kind do_get_entity_kind() const noexcept override;
 
     std::vector<cpp_doc_comment> comments_;
+    std::vector<std::string>     dependencies_;
 };
 
 /// \exclude
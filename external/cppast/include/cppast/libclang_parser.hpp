@@ -5,6 +5,7 @@
 #ifndef CPPAST_LIBCLANG_PARSER_HPP_INCLUDED
 #define CPPAST_LIBCLANG_PARSER_HPP_INCLUDED
 
+#include <functional>
 #include <stdexcept>
 
 #include <cppast/parser.hpp>
@@ -14,6 +15,29 @@ namespace cppast
 class libclang_compile_config;
 class libclang_compilation_database;
 
+/// A filter that decides which entities the [cppast::libclang_parser]() converts.
+///
+/// It is called with the fully qualified name of every named entity declared at file or namespace
+/// scope, e.g. `ns::foo`, or `ns::foo::bar` for a member function defined outside of its class.
+/// It returns `true` if the entity is to be parsed, and `false` if it is to be skipped, together
+/// with everything declared inside of it.
+/// A class is parsed anyway if the filter accepts a class nested in it, at any depth;
+/// it is asked about those by their qualified name as well, e.g. `ns::outer::inner`.
+/// Namespaces are always entered; unnamed entities and using directives are always parsed.
+using libclang_entity_filter = std::function<bool(const std::string&)>;
+
+/// A callback that is told when the [cppast::libclang_parser]() begins and ends a phase of parsing a
+/// file.
+///
+/// It is called with the name of the phase, the path of the file, and `true` when the phase begins
+/// or `false` when it ends.
+/// The phases are `preprocess`, `parse` for `clang_parseTranslationUnit2()`, and `convert` for
+/// building the entities, which includes matching the comments.
+/// A kept translation unit is reparsed in a `reparse` phase inside of `parse`,
+/// see [cppast::libclang_compile_config::precompiled_preamble]().
+/// It must not throw.
+using libclang_phase_observer = std::function<void(const char*, const std::string&, bool)>;
+
 namespace detail
 {
     struct libclang_compile_config_access
@@ -27,6 +51,18 @@ namespace detail
         static bool fast_preprocessing(const libclang_compile_config& config);
 
         static bool remove_comments_in_macro(const libclang_compile_config& config);
+
+        static bool in_process_preprocessing(const libclang_compile_config& config);
+
+        static bool precompiled_preamble(const libclang_compile_config& config);
+
+        static const std::vector<std::string>& precompiled_headers(
+            const libclang_compile_config& config);
+
+        static const libclang_entity_filter& entity_filter(const libclang_compile_config& config);
+
+        static const libclang_phase_observer& phase_observer(
+            const libclang_compile_config& config);
     };
 
     void for_each_file(const libclang_compilation_database& database, void* user_data,
@@ -154,6 +190,63 @@ public:
         remove_comments_in_macro_ = b;
     }
 
+    /// \effects Sets whether or not the preprocessing is done inside the process.
+    /// Default value is `false`.
+    /// \notes The in-process preprocessor does not invoke the clang binary at all.
+    /// It parses the unmodified file and takes includes from the translation unit,
+    /// and macros and comments from the source, skipping inactive conditional blocks.
+    /// Unlike the external preprocessor, macros used in the file are not expanded
+    /// before parsing, so entities that are generated by macros are not seen.
+    /// \notes If this option is `true`, `fast_preprocessing` and `remove_comments_in_macro`
+    /// have no effect.
+    void in_process_preprocessing(bool b) noexcept
+    {
+        in_process_preprocessing_ = b;
+    }
+
+    /// \effects Sets whether or not the translation unit is kept for reparsing.
+    /// Default value is `false`.
+    /// \notes If this option is `true`, the [cppast::libclang_parser]() precompiles the preamble of
+    /// the file, i.e. the includes at the beginning, and keeps the translation unit.
+    /// When the same file is parsed again with the same flags, it is reparsed,
+    /// which only processes the preamble again if it has changed.
+    /// Only the most recently parsed translation units are kept.
+    void precompiled_preamble(bool b) noexcept
+    {
+        precompiled_preamble_ = b;
+    }
+
+    /// \effects Adds a header that is precompiled and implicitly included in every file parsed with
+    /// this configuration.
+    /// The header is given as it is written in an include directive, with or without the `<>`.
+    /// \notes The [cppast::libclang_parser]() builds one precompiled header for all added headers
+    /// and reuses it for every file parsed with the same flags.
+    /// This avoids parsing common, heavy headers like the standard library over and over again.
+    /// The headers must be protected by include guards, as they are included twice otherwise.
+    void add_precompiled_header(std::string header)
+    {
+        precompiled_headers_.push_back(std::move(header));
+    }
+
+    /// \effects Sets the filter that decides which entities are parsed.
+    /// Default is no filter, i.e. every entity is parsed.
+    /// \notes Skipped entities are not converted and not registered in the index.
+    /// This saves most of the time spent on large files of which only a few entities are needed.
+    /// The filter must not have side effects, as it may be called by several parsers at once.
+    void set_entity_filter(libclang_entity_filter filter)
+    {
+        entity_filter_ = std::move(filter);
+    }
+
+    /// \effects Sets the callback that is told about the phases of parsing a file.
+    /// Default is no callback.
+    /// \notes This allows measuring where the time goes, per file and per phase.
+    /// Like the filter, it may be called by several parsers at once.
+    void set_phase_observer(libclang_phase_observer observer)
+    {
+        phase_observer_ = std::move(observer);
+    }
+
 private:
     void do_set_flags(cpp_standard standard, compile_flags flags) override;
 
@@ -170,10 +263,15 @@ private:
         return "libclang";
     }
 
-    std::string clang_binary_;
+    std::string              clang_binary_;
+    std::vector<std::string> precompiled_headers_;
+    libclang_entity_filter   entity_filter_;
+    libclang_phase_observer  phase_observer_;
     bool        write_preprocessed_ : 1;
     bool        fast_preprocessing_ : 1;
     bool        remove_comments_in_macro_ : 1;
+    bool        in_process_preprocessing_ : 1;
+    bool        precompiled_preamble_ : 1;
 
     friend detail::libclang_compile_config_access;
 };
@@ -15,13 +15,28 @@ cpp_entity_index::duplicate_definition_error::duplicate_definition_error()
 : std::logic_error("duplicate registration of entity definition")
 {}
 
+namespace
+{
+// must be called with the shard locked, freeze() holds all of them while it sets the flag
+bool check_not_frozen(bool frozen)
+{
+    DEBUG_ASSERT(!frozen, detail::precondition_error_handler{},
+                 "index is frozen, entities can no longer be registered");
+    // lookups no longer lock, so never write once frozen
+    return !frozen;
+}
+} // namespace
+
 void cpp_entity_index::register_definition(cpp_entity_id                           id,
                                            type_safe::object_ref<const cpp_entity> entity) const
 {
     DEBUG_ASSERT(entity->kind() != cpp_entity_kind::namespace_t,
                  detail::precondition_error_handler{}, "must not be a namespace");
-    std::lock_guard<std::mutex> lock(mutex_);
-    auto                        result = map_.emplace(std::move(id), value(entity, true));
+    auto&                       shard = get_shard(id);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (!check_not_frozen(is_frozen()))
+        return;
+    auto result = shard.map.emplace(std::move(id), value(entity, true));
     if (!result.second)
     {
         // already in map, override declaration
@@ -37,30 +52,62 @@ void cpp_entity_index::register_definition(cpp_entity_id
 bool cpp_entity_index::register_file(cpp_entity_id                         id,
                                      type_safe::object_ref<const cpp_file> file) const
 {
-    std::lock_guard<std::mutex> lock(mutex_);
-    return map_.emplace(std::move(id), value(file, true)).second;
+    auto&                       shard = get_shard(id);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (!check_not_frozen(is_frozen()))
+        return false;
+    return shard.map.emplace(std::move(id), value(file, true)).second;
 }
 
 void cpp_entity_index::register_forward_declaration(
     cpp_entity_id id, type_safe::object_ref<const cpp_entity> entity) const
 {
-    std::lock_guard<std::mutex> lock(mutex_);
-    map_.emplace(std::move(id), value(entity, false));
+    auto&                       shard = get_shard(id);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (!check_not_frozen(is_frozen()))
+        return;
+    shard.map.emplace(std::move(id), value(entity, false));
 }
 
 void cpp_entity_index::register_namespace(cpp_entity_id                              id,
                                           type_safe::object_ref<const cpp_namespace> ns) const
 {
-    std::lock_guard<std::mutex> lock(mutex_);
-    ns_[std::move(id)].push_back(ns);
+    auto&                       shard = get_shard(id);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (!check_not_frozen(is_frozen()))
+        return;
+    shard.ns[std::move(id)].push_back(ns);
+}
+
+void cpp_entity_index::freeze() noexcept
+{
+    if (is_frozen())
+        return;
+    // wait for registrations that are still running and keep new ones out until the flag is set,
+    // the release store then publishes everything they wrote
+    for (auto& shard : shards_)
+        shard.mutex.lock();
+    frozen_.store(true, std::memory_order_release);
+    for (auto& shard : shards_)
+        shard.mutex.unlock();
+}
+
+namespace
+{
+// only locks while the index can still change
+std::unique_lock<std::mutex> lock_unless_frozen(std::mutex& mutex, bool frozen)
+{
+    return frozen ? std::unique_lock<std::mutex>() : std::unique_lock<std::mutex>(mutex);
 }
+} // namespace
 
 type_safe::optional_ref<const cpp_entity> cpp_entity_index::lookup(const cpp_entity_id& id) const
     noexcept
 {
-    std::lock_guard<std::mutex> lock(mutex_);
-    auto                        iter = map_.find(id);
-    if (iter == map_.end())
+    auto& shard = get_shard(id);
+    auto  lock  = lock_unless_frozen(shard.mutex, is_frozen());
+    auto  iter  = shard.map.find(id);
+    if (iter == shard.map.end())
         return {};
     return type_safe::ref(iter->second.entity.get());
 }
@@ -68,9 +115,10 @@ type_safe::optional_ref<const cpp_entity> cpp_entity_index::lookup(const cpp_ent
 type_safe::optional_ref<const cpp_entity> cpp_entity_index::lookup_definition(
     const cpp_entity_id& id) const noexcept
 {
-    std::lock_guard<std::mutex> lock(mutex_);
-    auto                        iter = map_.find(id);
-    if (iter == map_.end() || !iter->second.is_definition)
+    auto& shard = get_shard(id);
+    auto  lock  = lock_unless_frozen(shard.mutex, is_frozen());
+    auto  iter  = shard.map.find(id);
+    if (iter == shard.map.end() || !iter->second.is_definition)
         return {};
     return type_safe::ref(iter->second.entity.get());
 }
@@ -78,9 +126,10 @@ type_safe::optional_ref<const cpp_entity> cpp_entity_index::lookup_definition(
 auto cpp_entity_index::lookup_namespace(const cpp_entity_id& id) const noexcept
     -> type_safe::array_ref<type_safe::object_ref<const cpp_namespace>>
 {
-    std::lock_guard<std::mutex> lock(mutex_);
-    auto                        iter = ns_.find(id);
-    if (iter == ns_.end())
+    auto& shard = get_shard(id);
+    auto  lock  = lock_unless_frozen(shard.mutex, is_frozen());
+    auto  iter  = shard.ns.find(id);
+    if (iter == shard.ns.end())
         return nullptr;
     auto& vec = iter->second;
     return type_safe::ref(vec.data(), vec.size());
@@ -14,7 +14,8 @@
 using namespace cppast;
 
 detail::cxtoken::cxtoken(const CXTranslationUnit& tu_unit, const CXToken& token)
-: value_(clang_getTokenSpelling(tu_unit, token)), kind_(clang_getTokenKind(token))
+: value_(clang_getTokenSpelling(tu_unit, token)), kind_(clang_getTokenKind(token)),
+  location_(clang_getTokenLocation(tu_unit, token))
 {}
 
 namespace
@@ -415,6 +416,20 @@ detail::cxtokenizer::cxtokenizer(const CXTranslationUnit& tu, const CXFile& file
     }
 }
 
+detail::cxtokenizer::cxtokenizer(const CXTranslationUnit& tu, const CXFile& file)
+: unmunch_(false)
+{
+    std::size_t size = 0u;
+    clang_getFileContents(tu, file, &size);
+    auto begin = clang_getLocationForOffset(tu, file, 0u);
+    auto end   = clang_getLocationForOffset(tu, file, unsigned(size));
+
+    simple_tokenizer tokenizer(tu, clang_getRange(begin, end));
+    tokens_.reserve(tokenizer.size());
+    for (auto i = 0u; i != tokenizer.size(); ++i)
+        tokens_.emplace_back(tu, tokenizer[i]);
+}
+
 void detail::skip(detail::cxtoken_stream& stream, const char* str)
 {
     if (*str)
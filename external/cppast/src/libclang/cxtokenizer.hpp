@@ -37,9 +37,16 @@ namespace detail
             return kind_;
         }
 
+        // valid as long as the translation unit is
+        const CXSourceLocation& location() const noexcept
+        {
+            return location_;
+        }
+
     private:
-        cxstring    value_;
-        CXTokenKind kind_;
+        cxstring         value_;
+        CXTokenKind      kind_;
+        CXSourceLocation location_;
     };
 
     inline bool operator==(const cxtoken& tok, const char* str) noexcept
@@ -69,6 +76,9 @@ namespace detail
     public:
         explicit cxtokenizer(const CXTranslationUnit& tu, const CXFile& file, const CXCursor& cur);
 
+        // tokenizes the whole file, comments included
+        explicit cxtokenizer(const CXTranslationUnit& tu, const CXFile& file);
+
         cxtoken_iterator begin() const noexcept
         {
             return tokens_.begin();
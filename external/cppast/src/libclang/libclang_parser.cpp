@@ -4,8 +4,15 @@
 
 #include <cppast/libclang_parser.hpp>
 
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <fstream>
+#include <mutex>
+#include <random>
+#include <unordered_map>
 #include <vector>
 
 #include <clang-c/CXCompilationDatabase.h>
@@ -51,6 +58,36 @@ bool detail::libclang_compile_config_access::remove_comments_in_macro(
     return config.remove_comments_in_macro_;
 }
 
+bool detail::libclang_compile_config_access::in_process_preprocessing(
+    const libclang_compile_config& config)
+{
+    return config.in_process_preprocessing_;
+}
+
+bool detail::libclang_compile_config_access::precompiled_preamble(
+    const libclang_compile_config& config)
+{
+    return config.precompiled_preamble_;
+}
+
+const std::vector<std::string>& detail::libclang_compile_config_access::precompiled_headers(
+    const libclang_compile_config& config)
+{
+    return config.precompiled_headers_;
+}
+
+const libclang_entity_filter& detail::libclang_compile_config_access::entity_filter(
+    const libclang_compile_config& config)
+{
+    return config.entity_filter_;
+}
+
+const libclang_phase_observer& detail::libclang_compile_config_access::phase_observer(
+    const libclang_compile_config& config)
+{
+    return config.phase_observer_;
+}
+
 libclang_compilation_database::libclang_compilation_database(const std::string& build_directory)
 {
     static_assert(std::is_same<database, CXCompilationDatabase>::value, "forgot to update type");
@@ -81,7 +118,8 @@ namespace
 
 libclang_compile_config::libclang_compile_config()
 : compile_config({}), write_preprocessed_(false), fast_preprocessing_(false),
-  remove_comments_in_macro_(false)
+  remove_comments_in_macro_(false), in_process_preprocessing_(false),
+  precompiled_preamble_(false)
 {
     // set given clang binary
     set_clang_binary(CPPAST_CLANG_BINARY);
@@ -246,11 +284,27 @@ libclang_compile_config::libclang_compile_config(const libclang_compilation_data
 
 namespace
 {
+// probing the clang binary spawns a process, which is by far the most expensive part of
+// creating a config, so remember the results for every binary
+std::mutex binary_mutex;
+
 bool is_valid_binary(const std::string& binary)
 {
+    static std::unordered_map<std::string, bool> cache;
+    {
+        std::lock_guard<std::mutex> lock(binary_mutex);
+        auto                        iter = cache.find(binary);
+        if (iter != cache.end())
+            return iter->second;
+    }
+
     tpl::Process process(binary + " -v", "", [](const char*, std::size_t) {},
                          [](const char*, std::size_t) {});
-    return process.get_exit_status() == 0;
+    auto valid = process.get_exit_status() == 0;
+
+    std::lock_guard<std::mutex> lock(binary_mutex);
+    cache.emplace(binary, valid);
+    return valid;
 }
 
 #if (defined(WIN32) || defined(_WIN32) || defined(__WIN32)) && !defined(__CYGWIN__)
@@ -259,11 +313,12 @@ bool is_valid_binary(const std::string& binary)
 #    define CPPAST_DETAIL_WINDOWS 0
 #endif
 
-void add_default_include_dirs(libclang_compile_config& config)
+std::vector<std::string> get_default_include_dirs(const std::string& binary)
 {
+    std::vector<std::string> result;
+
     std::string  verbose_output;
-    tpl::Process process(detail::libclang_compile_config_access::clang_binary(config)
-                             + " -x c++ -v -",
+    tpl::Process process(binary + " -x c++ -v -",
                          "", [](const char*, std::size_t) {},
                          [&](const char* str, std::size_t n) { verbose_output.append(str, n); },
                          true);
@@ -308,8 +363,33 @@ void add_default_include_dirs(libclang_compile_config& config)
                 path += c;
         }
 
-        config.add_include_dir(std::move(path));
+        result.push_back(std::move(path));
     }
+
+    return result;
+}
+
+void add_default_include_dirs(libclang_compile_config& config)
+{
+    static std::unordered_map<std::string, std::vector<std::string>> cache;
+
+    auto& binary = detail::libclang_compile_config_access::clang_binary(config);
+    std::vector<std::string> dirs;
+    {
+        std::lock_guard<std::mutex> lock(binary_mutex);
+        auto                        iter = cache.find(binary);
+        if (iter != cache.end())
+            dirs = iter->second;
+    }
+    if (dirs.empty())
+    {
+        dirs = get_default_include_dirs(binary);
+        std::lock_guard<std::mutex> lock(binary_mutex);
+        cache.emplace(binary, dirs);
+    }
+
+    for (auto& dir : dirs)
+        config.add_include_dir(dir);
 }
 } // namespace
 
@@ -443,8 +523,38 @@ struct libclang_parser::impl
 {
     detail::cxindex index;
 
+    // translation units kept for reparsing, least recently used first
+    struct cached_unit
+    {
+        std::string                path;
+        std::vector<std::string>   args;
+        detail::cxtranslation_unit tu;
+    };
+    std::vector<cached_unit> units;
+
+    // precompiled header files by the arguments and headers they were built from,
+    // empty if building failed
+    std::unordered_map<std::string, std::string> pch_files;
+
     impl() : index(clang_createIndex(0, 0)) // no diagnostic, other one is irrelevant
     {}
+
+    ~impl() noexcept
+    {
+        for (auto& pch : pch_files)
+            if (!pch.second.empty())
+                std::remove(pch.second.c_str());
+    }
+
+    std::vector<const char*> arguments(const diagnostic_logger&        logger,
+                                       const libclang_compile_config& config);
+
+    detail::cxtranslation_unit parse(const diagnostic_logger&        logger,
+                                     const libclang_compile_config& config, const std::string& path,
+                                     const std::string& source);
+
+    void keep(const diagnostic_logger& logger, const libclang_compile_config& config,
+              std::string path, detail::cxtranslation_unit tu);
 };
 
 libclang_parser::libclang_parser() : libclang_parser(default_logger()) {}
@@ -509,16 +619,14 @@ void print_diagnostics(const diagnostic_logger& logger, const CXTranslationUnit&
 }
 
 detail::cxtranslation_unit get_cxunit(const diagnostic_logger& logger, const detail::cxindex& idx,
-                                      const libclang_compile_config& config, const char* path,
-                                      const std::string& source)
+                                      const std::vector<const char*>& args, const char* path,
+                                      const std::string& source, unsigned extra_flags = 0u)
 {
     CXUnsavedFile file{path, source.c_str(), static_cast<unsigned long>(source.length())};
 
-    auto args = get_arguments(config);
-
     CXTranslationUnit tu;
     auto              flags = CXTranslationUnit_Incomplete | CXTranslationUnit_KeepGoing
-                 | CXTranslationUnit_DetailedPreprocessingRecord;
+                 | CXTranslationUnit_DetailedPreprocessingRecord | extra_flags;
 
     auto error
         = clang_parseTranslationUnit2(idx.get(), path, // index and path
@@ -549,6 +657,93 @@ detail::cxtranslation_unit get_cxunit(const diagnostic_logger& logger, const det
     return detail::cxtranslation_unit(tu);
 }
 
+// returns false if the translation unit could not be reparsed and must be discarded
+bool reparse_cxunit(const diagnostic_logger& logger, const detail::cxtranslation_unit& tu,
+                    const char* path, const std::string& source)
+{
+    CXUnsavedFile file{path, source.c_str(), static_cast<unsigned long>(source.length())};
+    if (clang_reparseTranslationUnit(tu.get(), 1, &file, clang_defaultReparseOptions(tu.get()))
+        != 0)
+        return false;
+
+    print_diagnostics(logger, tu.get());
+    return true;
+}
+
+// the directory for temporary files, with a trailing separator
+std::string get_temp_directory()
+{
+    for (auto name : {"TMPDIR", "TMP", "TEMP"})
+        if (auto dir = std::getenv(name))
+            if (*dir)
+            {
+                std::string result(dir);
+                if (result.back() != '/' && result.back() != '\\')
+                    result += CPPAST_DETAIL_WINDOWS ? '\\' : '/';
+                return result;
+            }
+
+    return CPPAST_DETAIL_WINDOWS ? "" : "/tmp/";
+}
+
+std::string get_pch_file_name()
+{
+    // the random part keeps concurrent processes apart
+    static std::atomic<unsigned> counter(0u);
+    std::random_device           random;
+    return get_temp_directory() + "cppast-pch-" + std::to_string(random()) + "-"
+           + std::to_string(++counter) + ".delete-me";
+}
+
+// precompiles the headers, returns the file name or an empty string if that failed
+std::string build_pch(const diagnostic_logger& logger, const detail::cxindex& idx,
+                      std::vector<const char*> args, const std::vector<std::string>& headers)
+{
+    std::string source;
+    for (auto& header : headers)
+        if (!header.empty() && (header.front() == '<' || header.front() == '"'))
+            source += "#include " + header + "\n";
+        else
+            source += "#include <" + header + ">\n";
+
+    DEBUG_ASSERT(args.size() > 1u && std::strcmp(args[1], "c++") == 0, detail::assert_handler{});
+    args[1] = "c++-header";
+
+    auto          file_name   = get_pch_file_name();
+    auto          header_name = file_name + ".hpp";
+    CXUnsavedFile file{header_name.c_str(), source.c_str(),
+                       static_cast<unsigned long>(source.length())};
+
+    CXTranslationUnit tu;
+    auto              error
+        = clang_parseTranslationUnit2(idx.get(), header_name.c_str(), args.data(),
+                                      static_cast<int>(args.size()), &file, 1,
+                                      unsigned(CXTranslationUnit_Incomplete
+                                               | CXTranslationUnit_ForSerialization
+                                               | CXTranslationUnit_DetailedPreprocessingRecord),
+                                      &tu);
+    if (error != CXError_Success)
+    {
+        logger.log("libclang", diagnostic{"unable to parse precompiled headers",
+                                          source_location::make_unknown(), severity::warning});
+        return "";
+    }
+
+    detail::cxtranslation_unit unit(tu);
+    if (clang_saveTranslationUnit(unit.get(), file_name.c_str(),
+                                  clang_defaultSaveOptions(unit.get()))
+        != CXSaveError_None)
+    {
+        print_diagnostics(logger, unit.get());
+        logger.log("libclang", diagnostic{"unable to save precompiled headers",
+                                          source_location::make_unknown(), severity::warning});
+        std::remove(file_name.c_str());
+        return "";
+    }
+
+    return file_name;
+}
+
 unsigned get_line_no(const CXCursor& cursor)
 {
     auto loc = clang_getCursorLocation(cursor);
@@ -557,7 +752,119 @@ unsigned get_line_no(const CXCursor& cursor)
     clang_getPresumedLocation(loc, nullptr, &line, nullptr);
     return line;
 }
+
+// how many translation units are kept for reparsing
+constexpr std::size_t max_cached_units = 16u;
+
+// tells the phase observer of the config about a phase for as long as it lives
+class phase_scope
+{
+public:
+    phase_scope(const libclang_compile_config& config, const char* phase, const std::string& path)
+    : observer_(detail::libclang_compile_config_access::phase_observer(config)),
+      phase_(phase),
+      path_(path)
+    {
+        if (observer_)
+            observer_(phase_, path_, true);
+    }
+
+    phase_scope(const phase_scope&) = delete;
+    phase_scope& operator=(const phase_scope&) = delete;
+
+    ~phase_scope()
+    {
+        if (observer_)
+            observer_(phase_, path_, false);
+    }
+
+private:
+    const libclang_phase_observer& observer_;
+    const char*                    phase_;
+    const std::string&             path_;
+};
+} // namespace
+
+std::vector<const char*> libclang_parser::impl::arguments(const diagnostic_logger&        logger,
+                                                          const libclang_compile_config& config)
+{
+    auto  args    = get_arguments(config);
+    auto& headers = detail::libclang_compile_config_access::precompiled_headers(config);
+    if (headers.empty())
+        return args;
+
+    std::string key;
+    for (auto arg : args)
+        key += std::string(arg) + '\n';
+    for (auto& header : headers)
+        key += header + '\n';
+
+    auto iter = pch_files.find(key);
+    if (iter == pch_files.end())
+        iter = pch_files.emplace(std::move(key), build_pch(logger, index, args, headers)).first;
+    if (!iter->second.empty())
+    {
+        args.push_back("-include-pch");
+        args.push_back(iter->second.c_str());
+    }
+    return args;
+}
+
+detail::cxtranslation_unit libclang_parser::impl::parse(const diagnostic_logger&        logger,
+                                                        const libclang_compile_config& config,
+                                                        const std::string&             path,
+                                                        const std::string&             source)
+{
+    auto args = arguments(logger, config);
+    if (!detail::libclang_compile_config_access::precompiled_preamble(config))
+        return get_cxunit(logger, index, args, path.c_str(), source);
+
+    std::vector<std::string> arg_strings(args.begin(), args.end());
+    auto iter = std::find_if(units.begin(), units.end(), [&](const cached_unit& unit) {
+        return unit.path == path && unit.args == arg_strings;
+    });
+    if (iter != units.end())
+    {
+        auto tu = std::move(iter->tu);
+        units.erase(iter);
+
+        phase_scope phase(config, "reparse", path);
+        if (reparse_cxunit(logger, tu, path.c_str(), source))
+            return tu;
+    }
+
+    return get_cxunit(logger, index, args, path.c_str(), source,
+                      CXTranslationUnit_PrecompiledPreamble
+                          | CXTranslationUnit_CreatePreambleOnFirstParse);
+}
+
+void libclang_parser::impl::keep(const diagnostic_logger& logger,
+                                 const libclang_compile_config& config, std::string path,
+                                 detail::cxtranslation_unit tu)
+{
+    if (!detail::libclang_compile_config_access::precompiled_preamble(config))
+        return;
+
+    auto args = arguments(logger, config);
+    units.push_back({std::move(path), std::vector<std::string>(args.begin(), args.end()),
+                     std::move(tu)});
+    if (units.size() > max_cached_units)
+        units.erase(units.begin());
+}
+
+namespace
+{
+// whether the cursor was written by a macro expansion, not in the file
+bool is_macro_expansion(const CXCursor& cur)
+{
+    auto     location = clang_getCursorLocation(cur);
+    unsigned spelling = 0u, expansion = 0u;
+    clang_getSpellingLocation(location, nullptr, nullptr, nullptr, &spelling);
+    clang_getExpansionLocation(location, nullptr, nullptr, nullptr, &expansion);
+    return spelling != expansion;
+}
 } // namespace
+
 std::unique_ptr<cpp_file> libclang_parser::do_parse(const cpp_entity_index& idx, std::string path,
                                                     const compile_config& c) const try
 {
@@ -565,16 +872,35 @@ std::unique_ptr<cpp_file> libclang_parser::do_parse(const cpp_entity_index& idx,
                  "config has mismatched type");
     auto& config = static_cast<const libclang_compile_config&>(c);
 
-    // preprocess
-    auto preprocessed = detail::preprocess(config, path.c_str(), logger());
+    // preprocess and parse
+    detail::preprocessor_output preprocessed;
+    detail::cxtranslation_unit  tu;
+    if (detail::libclang_compile_config_access::in_process_preprocessing(config))
+    {
+        // parse the file as it is and get the preprocessor output from the translation unit
+        auto source = detail::read_source(path.c_str());
+        {
+            phase_scope phase(config, "parse", path);
+            tu = pimpl_->parse(logger(), config, path, source);
+        }
+        phase_scope phase(config, "preprocess", path);
+        preprocessed = detail::preprocess(tu, path.c_str(), std::move(source), logger());
+    }
+    else
+    {
+        {
+            phase_scope phase(config, "preprocess", path);
+            preprocessed = detail::preprocess(config, path.c_str(), logger());
+        }
+        phase_scope phase(config, "parse", path);
+        tu = pimpl_->parse(logger(), config, path, preprocessed.source);
+    }
     if (detail::libclang_compile_config_access::write_preprocessed(config))
     {
         std::ofstream file(path + ".pp");
         file << preprocessed.source;
     }
 
-    // parse
-    auto tu   = get_cxunit(logger(), pimpl_->index, config, path.c_str(), preprocessed.source);
     auto file = clang_getFile(tu.get(), path.c_str());
 
     cpp_file::builder builder(detail::cxstring(clang_getFileName(file)).std_str());
@@ -582,12 +908,14 @@ std::unique_ptr<cpp_file> libclang_parser::do_parse(const cpp_entity_index& idx,
     auto              include_iter = preprocessed.includes.begin();
 
     // convert entity hierarchies
+    phase_scope           convert(config, "convert", path);
     detail::parse_context context{tu.get(),
                                   file,
                                   type_safe::ref(logger()),
                                   type_safe::ref(idx),
                                   detail::comment_context(preprocessed.comments),
-                                  false};
+                                  false,
+                                  &detail::libclang_compile_config_access::entity_filter(config)};
     detail::visit_tu(tu, path.c_str(), [&](const CXCursor& cur) {
         if (clang_getCursorKind(cur) == CXCursor_InclusionDirective)
         {
@@ -630,6 +958,16 @@ std::unique_ptr<cpp_file> libclang_parser::do_parse(const cpp_entity_index& idx,
                  macro_iter != preprocessed.macros.end() && macro_iter->line <= line; ++macro_iter)
                 builder.add_child(std::move(macro_iter->macro));
 
+            if (detail::libclang_compile_config_access::in_process_preprocessing(config)
+                && is_macro_expansion(cur))
+                // the tokens are those of the macro invocation, so the entity is likely
+                // missing or incomplete
+                logger().log("libclang parser",
+                             diagnostic{"declaration generated by a macro, which in-process "
+                                        "preprocessing does not see; preprocess externally "
+                                        "to get it",
+                                        detail::make_location(cur), severity::warning});
+
             auto entity = detail::parse_entity(context, &builder.get(), cur);
             if (entity)
                 builder.add_child(std::move(entity));
@@ -645,9 +983,13 @@ std::unique_ptr<cpp_file> libclang_parser::do_parse(const cpp_entity_index& idx,
             builder.add_unmatched_comment(cpp_doc_comment(std::move(cur.comment), cur.line));
     }
 
+    for (auto& dependency : preprocessed.dependencies)
+        builder.add_dependency(std::move(dependency));
+
     if (context.error)
         set_error();
 
+    pimpl_->keep(logger(), config, path, std::move(tu));
     return builder.finish(idx);
 }
 catch (detail::parse_error& ex)
@@ -4,6 +4,7 @@
 
 #include "parse_functions.hpp"
 
+#include <cppast/cpp_entity_kind.hpp>
 #include <cppast/cpp_static_assert.hpp>
 #include <cppast/cpp_storage_class_specifiers.hpp>
 
@@ -104,6 +105,80 @@ bool is_friend(const CXCursor& parent_cur)
 {
     return clang_getCursorKind(parent_cur) == CXCursor_FriendDecl;
 }
+
+// whether the entity is subject to the entity filter of the context
+bool is_filtered(const detail::parse_context& context, const cpp_entity* parent,
+                 const CXCursor& cur)
+{
+    if (!context.filter || !*context.filter || !parent)
+        return false;
+    switch (parent->kind())
+    {
+    case cpp_entity_kind::file_t:
+    case cpp_entity_kind::namespace_t:
+    case cpp_entity_kind::language_linkage_t:
+        break;
+    default:
+        // members are parsed together with their class
+        return false;
+    }
+    switch (clang_getCursorKind(cur))
+    {
+    case CXCursor_Namespace:
+    case CXCursor_NamespaceAlias:
+    case CXCursor_UsingDirective:
+    case CXCursor_UsingDeclaration:
+    case CXCursor_StaticAssert:
+    case CXCursor_UnexposedDecl:
+        return false;
+    default:
+        return true;
+    }
+}
+
+// the fully qualified name, following semantic parents,
+// so members defined outside of their class get the name of the class as well
+std::string get_qualified_name(const CXCursor& cur)
+{
+    std::string result = detail::cxstring(clang_getCursorSpelling(cur)).c_str();
+    for (auto parent = clang_getCursorSemanticParent(cur);
+         !clang_Cursor_isNull(parent) && !clang_isInvalid(clang_getCursorKind(parent))
+         && !clang_isTranslationUnit(clang_getCursorKind(parent));
+         parent = clang_getCursorSemanticParent(parent))
+    {
+        detail::cxstring name(clang_getCursorSpelling(parent));
+        if (!name.empty())
+            result = std::string(name.c_str()) + "::" + result;
+    }
+    return result;
+}
+
+bool is_class(const CXCursor& cur)
+{
+    switch (clang_getCursorKind(cur))
+    {
+    case CXCursor_ClassDecl:
+    case CXCursor_StructDecl:
+    case CXCursor_UnionDecl:
+    case CXCursor_ClassTemplate:
+    case CXCursor_ClassTemplatePartialSpecialization:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// whether the filter wants a class nested in the class, at any depth
+bool has_wanted_nested_class(const libclang_entity_filter& filter, const CXCursor& cur)
+{
+    auto result = false;
+    detail::visit_children(cur, [&](const CXCursor& child) {
+        if (result || !is_class(child) || detail::cxstring(clang_getCursorSpelling(child)).empty())
+            return;
+        result = filter(get_qualified_name(child)) || has_wanted_nested_class(filter, child);
+    });
+    return result;
+}
 } // namespace
 
 std::unique_ptr<cpp_entity> detail::parse_entity(const detail::parse_context& context,
@@ -118,6 +193,14 @@ std::unique_ptr<cpp_entity> detail::parse_entity(const detail::parse_context& co
                                               detail::get_cursor_kind_spelling(cur).c_str(), "'"));
     }
 
+    if (is_filtered(context, parent, cur))
+    {
+        detail::cxstring name(clang_getCursorSpelling(cur));
+        if (!name.empty() && !(*context.filter)(get_qualified_name(cur))
+            && !(is_class(cur) && has_wanted_nested_class(*context.filter, cur)))
+            return nullptr;
+    }
+
     auto kind = clang_getCursorKind(cur);
     switch (kind)
     {
@@ -6,6 +6,7 @@
 #define CPPAST_PARSE_FUNCTIONS_HPP_INCLUDED
 
 #include <cppast/cpp_entity.hpp>
+#include <cppast/libclang_parser.hpp>
 #include <cppast/parser.hpp>
 
 #include "cxtokenizer.hpp" // for convenience
@@ -56,6 +57,8 @@ namespace detail
         type_safe::object_ref<const cpp_entity_index>  idx;
         comment_context                                comments;
         mutable bool                                   error;
+        // entities at file or namespace scope are skipped unless it accepts them
+        const libclang_entity_filter*                  filter;
     };
 
     // parse default value of variable, function parameter...
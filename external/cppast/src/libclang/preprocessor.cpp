@@ -16,6 +16,7 @@
 
 #include <cppast/diagnostic.hpp>
 
+#include "libclang_visitor.hpp"
 #include "parse_error.hpp"
 
 using namespace cppast;
@@ -1142,6 +1143,10 @@ detail::preprocessor_output detail::preprocess(const libclang_compile_config& co
         {
             if (lm.value().flag == linemarker::enter_new)
             {
+                // <built-in> and <command line> are not files
+                if (!lm.value().file.empty() && lm.value().file.front() != '<')
+                    result.dependencies.push_back(lm.value().file);
+
                 if (p.write_enabled())
                 {
                     // this is a direct include, update the full path of the last include
@@ -1240,3 +1245,369 @@ detail::preprocessor_output detail::preprocess(const libclang_compile_config& co
 
     return result;
 }
+
+//=== in-process preprocessing ===//
+namespace
+{
+bool is_identifier_char(char c)
+{
+    return c == '_' || std::isalnum(static_cast<unsigned char>(c));
+}
+
+// collapses whitespace outside of literals and trims it,
+// which matches the way clang prints macro replacements
+std::string normalize_replacement(const char* ptr)
+{
+    std::string result;
+    auto        quote = '\0';
+    for (; *ptr; ++ptr)
+    {
+        if (quote)
+        {
+            result += *ptr;
+            if (*ptr == '\\' && ptr[1])
+                result += *++ptr;
+            else if (*ptr == quote)
+                quote = '\0';
+        }
+        else if (*ptr == ' ')
+        {
+            if (!result.empty() && result.back() != ' ')
+                result += ' ';
+        }
+        else
+        {
+            if (*ptr == '"' || *ptr == '\'')
+                quote = *ptr;
+            result += *ptr;
+        }
+    }
+
+    while (!result.empty() && result.back() == ' ')
+        result.pop_back();
+    return result;
+}
+
+// brings a directive into the form clang -E -dD prints it,
+// so it can be handled by the same parsing functions
+std::string canonical_directive(const std::string& line)
+{
+    auto ptr         = line.c_str();
+    auto skip_spaces = [&] {
+        while (*ptr == ' ')
+            ++ptr;
+    };
+
+    skip_spaces();
+    DEBUG_ASSERT(*ptr == '#', detail::assert_handler{});
+    ++ptr;
+    skip_spaces();
+
+    std::string directive;
+    while (is_identifier_char(*ptr))
+        directive += *ptr++;
+    skip_spaces();
+
+    if (directive == "undef")
+        return "#undef " + normalize_replacement(ptr);
+    else if (directive != "define")
+        // includes are taken from the translation unit and conditionals are already resolved,
+        // so the rest of the line is not needed
+        return "#" + directive;
+
+    std::string result = "#define ";
+    while (is_identifier_char(*ptr))
+        result += *ptr++;
+    if (*ptr == '(')
+    {
+        // parameters are printed without whitespace
+        for (; *ptr && *ptr != ')'; ++ptr)
+            if (*ptr != ' ')
+                result += *ptr;
+        if (*ptr == ')')
+            result += *ptr++;
+    }
+    return result + " " + normalize_replacement(ptr);
+}
+
+// returns whether a C comment is still open at the end of the line
+bool in_c_comment_after(const std::string& line, bool in_comment)
+{
+    auto quote = '\0';
+    for (auto ptr = line.c_str(); *ptr; ++ptr)
+    {
+        if (in_comment)
+        {
+            if (ptr[0] == '*' && ptr[1] == '/')
+            {
+                in_comment = false;
+                ++ptr;
+            }
+        }
+        else if (quote)
+        {
+            if (*ptr == '\\' && ptr[1])
+                ++ptr;
+            else if (*ptr == quote)
+                quote = '\0';
+        }
+        else if (ptr[0] == '/' && ptr[1] == '/')
+            break;
+        else if (ptr[0] == '/' && ptr[1] == '*')
+        {
+            in_comment = true;
+            ++ptr;
+        }
+        else if (*ptr == '"' || *ptr == '\'')
+            quote = *ptr;
+    }
+    return in_comment;
+}
+
+// returns the source as the external preprocessor would print it:
+// inactive blocks blanked out, tabs converted to spaces,
+// and every directive in canonical form on a single line
+std::string normalize_source(std::string source, const CXTranslationUnit& tu, const CXFile& file)
+{
+    // keep the newlines so the line numbers stay the same
+    auto skipped = clang_getSkippedRanges(tu, file);
+    for (auto i = 0u; i != skipped->count; ++i)
+    {
+        unsigned begin, end;
+        clang_getSpellingLocation(clang_getRangeStart(skipped->ranges[i]), nullptr, nullptr,
+                                  nullptr, &begin);
+        clang_getSpellingLocation(clang_getRangeEnd(skipped->ranges[i]), nullptr, nullptr, nullptr,
+                                  &end);
+        for (auto j = begin; j < end && j < source.size(); ++j)
+            if (source[j] != '\n')
+                source[j] = ' ';
+    }
+    clang_disposeSourceRangeList(skipped);
+
+    auto ptr       = source.c_str();
+    auto read_line = [&](std::string& line) {
+        for (; *ptr && *ptr != '\n'; ++ptr)
+            if (*ptr == '\t')
+                line += ' ';
+            else if (*ptr != '\r')
+                line += *ptr;
+        if (*ptr)
+            ++ptr;
+    };
+
+    std::string result;
+    result.reserve(source.size());
+    auto in_comment = false;
+    while (*ptr)
+    {
+        std::string line;
+        read_line(line);
+
+        auto first = line.find_first_not_of(' ');
+        if (!in_comment && first != std::string::npos && line[first] == '#')
+        {
+            auto continuations = 0u;
+            while (!line.empty() && line.back() == '\\' && *ptr)
+            {
+                line.pop_back();
+                read_line(line);
+                ++continuations;
+            }
+
+            result += canonical_directive(line);
+            result.append(continuations + 1u, '\n');
+        }
+        else
+        {
+            in_comment = in_c_comment_after(line, in_comment);
+            result += line;
+            result += '\n';
+        }
+    }
+    return result;
+}
+
+cpp_include_kind get_include_kind(const CXTranslationUnit& tu, const CXCursor& cur)
+{
+    CXToken* tokens;
+    unsigned no;
+    clang_tokenize(tu, clang_getCursorExtent(cur), &tokens, &no);
+
+    // the file name is either a string literal or starts with <
+    // computed includes are treated as system includes
+    auto kind = cpp_include_kind::system;
+    for (auto i = 0u; i != no; ++i)
+    {
+        detail::cxstring spelling(clang_getTokenSpelling(tu, tokens[i]));
+        if (spelling[0] == '"')
+        {
+            kind = cpp_include_kind::local;
+            break;
+        }
+        else if (spelling[0] == '<')
+            break;
+    }
+
+    clang_disposeTokens(tu, tokens, no);
+    return kind;
+}
+
+std::vector<detail::pp_include> get_includes(const detail::cxtranslation_unit& tu,
+                                             const char*                       path)
+{
+    std::vector<detail::pp_include> result;
+    detail::visit_tu(tu, path, [&](const CXCursor& cur) {
+        if (clang_getCursorKind(cur) != CXCursor_InclusionDirective)
+            return;
+
+        unsigned line;
+        clang_getPresumedLocation(clang_getCursorLocation(cur), nullptr, &line, nullptr);
+
+        auto file_name = detail::cxstring(clang_getCursorSpelling(cur)).std_str();
+        if (file_name.size() > 2u && file_name[0] == '.'
+            && (file_name[1] == '/' || file_name[1] == '\\'))
+            file_name = file_name.substr(2);
+
+        std::string full_path;
+        if (auto included = clang_getIncludedFile(cur))
+            full_path = detail::cxstring(clang_getFileName(included)).std_str();
+
+        result.push_back({std::move(file_name), std::move(full_path),
+                          get_include_kind(tu.get(), cur), line});
+    });
+    return result;
+}
+
+std::vector<std::string> get_dependencies(const detail::cxtranslation_unit& tu)
+{
+    std::vector<std::string> result;
+    clang_getInclusions(tu.get(),
+                        [](CXFile file, CXSourceLocation*, unsigned depth, CXClientData data) {
+                            // depth 0 is the main file itself
+                            if (depth > 0u)
+                                static_cast<std::vector<std::string>*>(data)->push_back(
+                                    detail::cxstring(clang_getFileName(file)).std_str());
+                        },
+                        &result);
+    return result;
+}
+} // namespace
+
+std::string detail::read_source(const char* path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        throw libclang_error("preprocessor: file '" + std::string(path) + "' doesn't exist");
+
+    // read it in one go where the size is known, going through the stream buffer is slow
+    file.seekg(0, std::ios::end);
+    auto size = static_cast<std::streamoff>(file.tellg());
+    if (size <= 0)
+    {
+        file.clear();
+        file.seekg(0);
+        return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    std::string result(static_cast<std::size_t>(size), '\0');
+    file.seekg(0);
+    file.read(&result[0], static_cast<std::streamsize>(size));
+    result.resize(static_cast<std::size_t>(file.gcount()));
+    return result;
+}
+
+void detail::parse_doc_comment(std::vector<pp_doc_comment>& comments, const char* comment,
+                               unsigned line, unsigned column)
+{
+    // the tokenizer does not include the newline that ends a C++ style comment
+    std::string source = std::string(comment) + "\n";
+
+    std::string ignored;
+    position    p(ts::ref(ignored), source.c_str());
+    // the indentation of a C comment is relative to the column it starts at
+    p.set_line(line);
+    p.write_str(std::string(column - 1u, ' '));
+
+    detail::preprocessor_output output;
+    output.comments = std::move(comments);
+    if (!skip_c_comment(p, output))
+        skip_cpp_comment(p, output);
+    comments = std::move(output.comments);
+}
+
+detail::preprocessor_output detail::preprocess(const cxtranslation_unit& tu, const char* path,
+                                               std::string source, const diagnostic_logger& logger)
+{
+    detail::preprocessor_output result;
+    result.includes     = get_includes(tu, path);
+    result.dependencies = get_dependencies(tu);
+
+    auto file       = clang_getFile(tu.get(), path);
+    auto normalized = normalize_source(source, tu.get(), file);
+    // the parser gets the file as it is
+    result.source = std::move(source);
+
+    // only scanned for comments and macro directives
+    std::string scanned;
+    position    p(ts::ref(scanned), normalized.c_str());
+    ts::flag    in_string(false), in_char(false);
+    while (p)
+    {
+        auto next = std::strpbrk(p.ptr(), R"(\"'#/)"); // look for \, ", ', # or /
+        if (next && next > p.ptr())
+            p.bump(std::size_t(next - p.ptr() - 1)); // subtract one to get before that character
+
+        if (starts_with(p, R"(\\)")) // starts with two backslashes
+            p.bump(2u);
+        else if (starts_with(p, R"(\")")) // starts with \"
+            p.bump(2u);
+        else if (starts_with(p, R"(\')")) // starts with \'
+            p.bump(2u);
+        else if (in_char == false && starts_with(p, R"(")")) // starts with "
+        {
+            p.bump();
+            in_string.toggle();
+        }
+        else if (in_string == false && starts_with(p, "'"))
+        {
+            p.bump();
+            in_char.toggle();
+        }
+        else if (in_string == true || in_char == true)
+            p.bump();
+        else if (auto macro = parse_macro(p, result))
+        {
+            if (logger.is_verbose())
+                logger.log("preprocessor",
+                           format_diagnostic(severity::debug,
+                                             source_location::make_file(path, p.cur_line()),
+                                             "parsing macro '", macro->name(), "'"));
+
+            result.macros.push_back({std::move(macro), p.cur_line()});
+        }
+        else if (auto undef = parse_undef(p))
+        {
+            if (logger.is_verbose())
+                logger.log("preprocessor",
+                           format_diagnostic(severity::debug,
+                                             source_location::make_file(path, p.cur_line()),
+                                             "undefining macro '", undef.value(), "'"));
+
+            result.macros.erase(std::remove_if(result.macros.begin(), result.macros.end(),
+                                               [&](const pp_macro& e) {
+                                                   return e.macro->name() == undef.value();
+                                               }),
+                                result.macros.end());
+        }
+        else if (bump_pragma(p))
+            continue;
+        else if (skip_c_comment(p, result))
+            continue;
+        else if (skip_cpp_comment(p, result))
+            continue;
+        else
+            p.bump();
+    }
+
+    return result;
+}
@@ -8,6 +8,8 @@
 #include <cppast/cpp_preprocessor.hpp>
 #include <cppast/libclang_parser.hpp>
 
+#include "raii_wrapper.hpp"
+
 namespace cppast
 {
 namespace detail
@@ -45,10 +47,27 @@ namespace detail
         std::vector<pp_include>     includes;
         std::vector<pp_macro>       macros;
         std::vector<pp_doc_comment> comments;
+        // full paths of every file included, directly or indirectly
+        std::vector<std::string> dependencies;
     };
 
     preprocessor_output preprocess(const libclang_compile_config& config, const char* path,
                                    const diagnostic_logger& logger);
+
+    // parses a single comment, as spelled by the tokenizer, that starts at line and column
+    // (both starting at 1)
+    // if it is a doc comment, it is added to comments,
+    // or merged into the last one, exactly like preprocess() does
+    void parse_doc_comment(std::vector<pp_doc_comment>& comments, const char* comment,
+                           unsigned line, unsigned column);
+
+    // reads the unmodified source of a file, as needed for the in-process preprocessor
+    std::string read_source(const char* path);
+
+    // in-process preprocessing, without invoking the clang binary
+    // tu must have been parsed from source with a detailed preprocessing record
+    preprocessor_output preprocess(const cxtranslation_unit& tu, const char* path,
+                                   std::string source, const diagnostic_logger& logger);
 } // namespace detail
 } // namespace cppast
 
@@ -0,0 +1,182 @@
+// Copyright (C) 2017-2019 Jonathan Müller <jonathanmueller.dev@gmail.com>
+// This file is subject to the license terms in the LICENSE file
+// found in the top-level directory of this distribution.
+
+#include <cppast/cpp_entity_index.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+#include <cppast/cpp_namespace.hpp>
+#include <cppast/cpp_type_alias.hpp>
+
+#include "test_parser.hpp"
+
+using namespace cppast;
+
+namespace
+{
+std::vector<std::unique_ptr<cpp_type_alias>> make_aliases(std::size_t count)
+{
+    std::vector<std::unique_ptr<cpp_type_alias>> result;
+    result.reserve(count);
+    for (auto i = 0u; i != count; ++i)
+        result.push_back(
+            cpp_type_alias::build("a" + std::to_string(i), cpp_builtin_type::build(cpp_int)));
+    return result;
+}
+
+cpp_entity_id alias_id(std::size_t i)
+{
+    return cpp_entity_id("a" + std::to_string(i));
+}
+
+bool refers_to(type_safe::optional_ref<const cpp_entity> entity, const cpp_entity& expected)
+{
+    return entity && &entity.value() == &expected;
+}
+
+template <typename Func>
+void run_threads(unsigned count, Func func)
+{
+    std::vector<std::thread> threads;
+    for (auto i = 0u; i != count; ++i)
+        threads.emplace_back(func, i);
+    for (auto& thread : threads)
+        thread.join();
+}
+} // namespace
+
+TEST_CASE("cpp_entity_index")
+{
+    cpp_entity_index idx;
+    auto             aliases = make_aliases(2u);
+
+    REQUIRE(!idx.lookup(alias_id(0u)));
+
+    idx.register_forward_declaration(alias_id(0u), type_safe::ref(*aliases[0u]));
+    REQUIRE(refers_to(idx.lookup(alias_id(0u)), *aliases[0u]));
+    REQUIRE(!idx.lookup_definition(alias_id(0u)));
+
+    // the definition replaces the declaration, a second one is an error
+    idx.register_definition(alias_id(0u), type_safe::ref(*aliases[1u]));
+    REQUIRE(refers_to(idx.lookup_definition(alias_id(0u)), *aliases[1u]));
+    REQUIRE_THROWS_AS(idx.register_definition(alias_id(0u), type_safe::ref(*aliases[0u])),
+                      cpp_entity_index::duplicate_definition_error);
+
+    cpp_namespace::builder a("ns", false, false), b("ns", false, false);
+    auto                   first  = a.finish(idx, "ns"_id);
+    auto                   second = b.finish(idx, "ns"_id);
+    REQUIRE(static_cast<std::size_t>(idx.lookup_namespace("ns"_id).size()) == 2u);
+    REQUIRE(!idx.lookup("ns"_id));
+
+    REQUIRE(!idx.is_frozen());
+    idx.freeze();
+    REQUIRE(idx.is_frozen());
+    REQUIRE(refers_to(idx.lookup(alias_id(0u)), *aliases[1u]));
+    REQUIRE(static_cast<std::size_t>(idx.lookup_namespace("ns"_id).size()) == 2u);
+    REQUIRE(!idx.lookup(alias_id(1u)));
+}
+
+TEST_CASE("cpp_entity_index parallel registration")
+{
+    const auto thread_count = 8u;
+    const auto count        = 20000u;
+    auto       aliases      = make_aliases(count);
+
+    cpp_entity_index         idx;
+    std::atomic<bool>        done(false);
+    std::atomic<std::size_t> duplicates(0u), wrong(0u);
+
+    // reads while everything is registered
+    std::thread reader([&] {
+        while (!done)
+            for (auto i = 0u; i < count; i += 97u)
+            {
+                auto entity = idx.lookup(alias_id(i));
+                if (entity && !refers_to(entity, *aliases[i]))
+                    ++wrong;
+            }
+    });
+
+    // every thread declares every entity, and tries to define it
+    run_threads(thread_count, [&](unsigned thread) {
+        for (auto j = 0u; j != count; ++j)
+        {
+            auto i = (j + thread * count / thread_count) % count;
+            idx.register_forward_declaration(alias_id(i), type_safe::ref(*aliases[i]));
+            try
+            {
+                idx.register_definition(alias_id(i), type_safe::ref(*aliases[i]));
+            }
+            catch (cpp_entity_index::duplicate_definition_error&)
+            {
+                ++duplicates;
+            }
+        }
+    });
+    done = true;
+    reader.join();
+
+    REQUIRE(wrong == 0u);
+    REQUIRE(duplicates == (thread_count - 1u) * count);
+
+    idx.freeze();
+    run_threads(thread_count, [&](unsigned thread) {
+        for (auto i = thread; i < count; i += thread_count)
+            if (!refers_to(idx.lookup_definition(alias_id(i)), *aliases[i]))
+                ++wrong;
+    });
+    REQUIRE(wrong == 0u);
+}
+
+// run with `cppast_test [benchmark]`
+TEST_CASE("cpp_entity_index contention", "[.][benchmark]")
+{
+    const auto count   = 1u << 18;
+    auto       aliases = make_aliases(count);
+
+    std::vector<cpp_entity_id> ids;
+    for (auto i = 0u; i != count; ++i)
+        ids.push_back(alias_id(i));
+
+    std::cout << "threads  register (ms)  lookup (ms)  frozen lookup (ms)\n";
+    for (auto thread_count = 1u; thread_count <= 64u; thread_count *= 2u)
+    {
+        using clock = std::chrono::steady_clock;
+        auto ms     = [](clock::time_point start) {
+            return std::chrono::duration<double, std::milli>(clock::now() - start).count();
+        };
+
+        cpp_entity_index idx;
+        auto             start = clock::now();
+        run_threads(thread_count, [&](unsigned thread) {
+            for (auto i = thread; i < count; i += thread_count)
+                idx.register_definition(ids[i], type_safe::ref(*aliases[i]));
+        });
+        auto registered = ms(start);
+
+        std::atomic<std::size_t> found(0u);
+        auto                     lookup_all = [&](unsigned) {
+            std::size_t result = 0u;
+            for (auto i = 0u; i != count; ++i)
+                result += idx.lookup(ids[i]).has_value() ? 1u : 0u;
+            found += result;
+        };
+
+        start = clock::now();
+        run_threads(thread_count, lookup_all);
+        auto looked_up = ms(start);
+
+        idx.freeze();
+        start = clock::now();
+        run_threads(thread_count, lookup_all);
+        auto frozen = ms(start);
+
+        REQUIRE(found == 2u * thread_count * count);
+        std::cout << thread_count << '\t' << registered << '\t' << looked_up << '\t' << frozen
+                  << '\n';
+    }
+}
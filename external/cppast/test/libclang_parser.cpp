@@ -8,6 +8,8 @@
 
 #include <fstream>
 
+#include "test_parser.hpp"
+
 using namespace cppast;
 
 libclang_compilation_database get_database(const char* json)
@@ -107,3 +109,175 @@ TEST_CASE("libclang_compile_config")
     libclang_compile_config c(database, CPPAST_DETAIL_DRIVE "/c.cpp");
     require_flags(c, "-std=c++14 -fms-extensions -fms-compatibility -fno-strict-aliasing");
 }
+
+TEST_CASE("libclang_parser precompiled preamble and headers")
+{
+    auto config = make_test_config();
+    config.precompiled_preamble(true);
+    config.add_precompiled_header("vector");
+    config.add_precompiled_header("<string>");
+
+    auto reparsed = 0;
+    config.set_phase_observer([&](const char* phase, const std::string&, bool begin) {
+        if (begin && std::string(phase) == "reparse")
+            ++reparsed;
+    });
+
+    libclang_parser p(default_logger());
+    auto            parse_names = [&](const char* code) {
+        write_file("precompiled_preamble.cpp", code);
+
+        cpp_entity_index idx;
+        auto             file = p.parse(idx, "precompiled_preamble.cpp", config);
+        REQUIRE(file);
+        REQUIRE(!p.error());
+
+        std::string names;
+        for (auto& e : *file)
+            names += e.name() + " ";
+        return names;
+    };
+
+    REQUIRE(parse_names(R"(
+#include <vector>
+#include <string>
+
+std::vector<std::string> a;
+)") == "vector string a ");
+    REQUIRE(reparsed == 0);
+
+    // same preamble, the translation unit is reparsed
+    REQUIRE(parse_names(R"(
+#include <vector>
+#include <string>
+
+std::vector<std::string> b;
+int c;
+)") == "vector string b c ");
+    REQUIRE(reparsed == 1);
+
+    // changed preamble
+    REQUIRE(parse_names(R"(
+#include <string>
+
+std::string d;
+)") == "string d ");
+    // the kept translation unit is reparsed again, which rebuilds the preamble
+    REQUIRE(reparsed == 2);
+}
+
+TEST_CASE("libclang_parser entity filter")
+{
+    write_file("entity_filter.cpp", R"(
+namespace ns
+{
+    struct wanted
+    {
+        void f();
+        int member;
+    };
+
+    struct unwanted
+    {
+        void g();
+    };
+
+    void free_function();
+}
+
+void ns::wanted::f() {}
+void ns::unwanted::g() {}
+
+int global;
+)");
+
+    std::vector<std::string> seen;
+    auto                     config = make_test_config();
+    config.set_entity_filter([&](const std::string& name) {
+        seen.push_back(name);
+        return name.compare(0, 10, "ns::wanted") == 0;
+    });
+
+    libclang_parser  p(default_logger());
+    cpp_entity_index idx;
+    auto             file = p.parse(idx, "entity_filter.cpp", config);
+    REQUIRE(file);
+    REQUIRE(!p.error());
+
+    std::string names;
+    visit(*file, [&](const cpp_entity& e, visitor_info info) {
+        if (info.event != visitor_info::container_entity_exit && e.kind() != cpp_file::kind())
+            names += e.name() + " ";
+        return true;
+    });
+    REQUIRE(names == "ns wanted f member f ");
+
+    // only entities at namespace scope are filtered, members are parsed with their class
+    REQUIRE(seen
+            == std::vector<std::string>{"ns::wanted", "ns::unwanted", "ns::free_function",
+                                        "ns::wanted::f", "ns::unwanted::g", "global"});
+}
+
+TEST_CASE("libclang_parser entity filter nested classes")
+{
+    write_file("entity_filter_nested.cpp", R"(
+struct outer
+{
+    struct middle
+    {
+        struct wanted {};
+    };
+
+    void f();
+};
+
+struct unwanted
+{
+    struct inner {};
+};
+)");
+
+    auto config = make_test_config();
+    config.set_entity_filter(
+        [&](const std::string& name) { return name == "outer::middle::wanted"; });
+
+    libclang_parser  p(default_logger());
+    cpp_entity_index idx;
+    auto             file = p.parse(idx, "entity_filter_nested.cpp", config);
+    REQUIRE(file);
+    REQUIRE(!p.error());
+
+    // the class is parsed for the class nested in it, with all of its members
+    std::string names;
+    visit(*file, [&](const cpp_entity& e, visitor_info info) {
+        if (info.event != visitor_info::container_entity_exit && e.kind() != cpp_file::kind())
+            names += e.name() + " ";
+        return true;
+    });
+    REQUIRE(names == "outer middle wanted f ");
+}
+
+TEST_CASE("libclang_parser phase observer")
+{
+    write_file("phase_observer.cpp", R"(
+/// documented
+struct a {};
+)");
+
+    std::string phases;
+    auto        config = make_test_config();
+    config.set_phase_observer([&](const char* phase, const std::string& path, bool begin) {
+        REQUIRE(path == "phase_observer.cpp");
+        phases += (begin ? "+" : "-") + std::string(phase) + " ";
+    });
+
+    libclang_parser  p(default_logger());
+    cpp_entity_index idx;
+    REQUIRE(p.parse(idx, "phase_observer.cpp", config));
+    REQUIRE(!p.error());
+
+    if (detail::libclang_compile_config_access::in_process_preprocessing(config))
+        REQUIRE(phases == "+parse -parse +preprocess -preprocess +convert -convert ");
+    else
+        REQUIRE(phases == "+preprocess -preprocess +parse -parse +convert -convert ");
+}
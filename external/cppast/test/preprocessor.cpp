@@ -4,6 +4,7 @@
 #include "libclang/preprocessor.hpp"
 #include "test_parser.hpp"
 
+#include <cppast/cpp_preprocessor.hpp>
 #include <cppast/cpp_variable.hpp>
 
 using namespace cppast;
@@ -307,3 +308,223 @@ void j();
     }
     REQUIRE((file->unmatched_comments().size() == 3u + add));
 }
+
+namespace
+{
+// describes everything the preprocessor adds to the file, in order
+std::string describe_preprocessed(const char* name, bool in_process)
+{
+    auto config = make_test_config();
+    config.in_process_preprocessing(in_process);
+
+    cpp_entity_index idx;
+    libclang_parser  p(default_logger());
+    auto             file = p.parse(idx, name, config);
+    REQUIRE(file);
+    REQUIRE(!p.error());
+
+    std::string result;
+    for (auto& e : *file)
+    {
+        if (e.kind() == cpp_entity_kind::macro_definition_t)
+        {
+            auto& macro = static_cast<const cpp_macro_definition&>(e);
+            result += "macro " + macro.name();
+            if (macro.is_function_like())
+            {
+                result += "(";
+                for (auto& param : macro.parameters())
+                    result += param.name() + ",";
+                if (macro.is_variadic())
+                    result += "...";
+                result += ")";
+            }
+            result += " '" + macro.replacement() + "'";
+        }
+        else if (e.kind() == cpp_entity_kind::include_directive_t)
+        {
+            auto& include = static_cast<const cpp_include_directive&>(e);
+            result += "include " + include.target().name();
+            result += include.include_kind() == cpp_include_kind::local ? " local " : " system ";
+            result += include.full_path();
+        }
+        else
+            result += "entity " + e.name();
+
+        if (e.comment())
+            result += " /// " + e.comment().value();
+        result += "\n";
+    }
+
+    for (auto& comment : file->unmatched_comments())
+        result += "unmatched " + std::to_string(comment.line) + " " + comment.content + "\n";
+
+    return result;
+}
+} // namespace
+
+TEST_CASE("in-process preprocessing")
+{
+    write_file("in_process_preprocessing.hpp", R"(
+#ifndef IN_PROCESS_PREPROCESSING_HPP
+#define IN_PROCESS_PREPROCESSING_HPP
+
+/// header
+struct header {};
+
+#endif
+)");
+    write_file("in_process_preprocessing.cpp", R"(
+#include "in_process_preprocessing.hpp"
+#include <cstddef>
+
+/// a
+#define A 1
+#define B(x, y)   ((x)  +  (y))
+#define C(fmt, ...) \
+    printf(fmt, \
+           __VA_ARGS__)
+
+#define D "string  with  spaces"
+#undef A
+
+#if 0
+/// not seen
+#define E
+#else
+	#  define F	2
+#endif
+
+/// b
+struct b
+{
+    int member; //< member
+};
+
+/* not documentation */
+/** c
+ * c */
+void c();
+
+/// unmatched
+)");
+
+    auto external   = describe_preprocessed("in_process_preprocessing.cpp", false);
+    auto in_process = describe_preprocessed("in_process_preprocessing.cpp", true);
+    REQUIRE(in_process == external);
+}
+
+TEST_CASE("parse_doc_comment")
+{
+    std::vector<detail::pp_doc_comment> comments;
+    detail::parse_doc_comment(comments, "// not documentation", 1u, 1u);
+    detail::parse_doc_comment(comments, "/* neither */", 2u, 1u);
+    REQUIRE(comments.empty());
+
+    // merged like the preprocessor does
+    detail::parse_doc_comment(comments, "/// first", 3u, 5u);
+    detail::parse_doc_comment(comments, "//! second", 4u, 5u);
+    REQUIRE(comments.size() == 1u);
+    REQUIRE(comments[0].comment == "first\nsecond");
+    REQUIRE(comments[0].line == 4u);
+    REQUIRE(comments[0].kind == detail::pp_doc_comment::cpp);
+
+    // indentation is relative to the column
+    detail::parse_doc_comment(comments, "/** c style\n     *  continued */", 5u, 5u);
+    REQUIRE(comments.size() == 2u);
+    REQUIRE(comments[1].comment == "c style\n continued");
+    REQUIRE(comments[1].line == 6u);
+    REQUIRE(comments[1].kind == detail::pp_doc_comment::c);
+
+    detail::parse_doc_comment(comments, "//< end of line", 7u, 20u);
+    REQUIRE(comments.size() == 3u);
+    REQUIRE(comments[2].comment == "end of line");
+    REQUIRE(comments[2].line == 7u);
+    REQUIRE(comments[2].kind == detail::pp_doc_comment::end_of_line);
+}
+
+TEST_CASE("dependencies")
+{
+    write_file("dependencies_inner.hpp", "struct inner {};\n");
+    write_file("dependencies_outer.hpp", "#include \"dependencies_inner.hpp\"\n");
+    write_file("dependencies.cpp", "#include \"dependencies_outer.hpp\"\nstruct a {};\n");
+
+    auto has = [](const cpp_file& file, const std::string& name) {
+        for (auto& path : file.dependencies())
+            if (path.size() >= name.size()
+                && path.compare(path.size() - name.size(), name.size(), name) == 0)
+                return true;
+        return false;
+    };
+
+    for (auto in_process : {false, true})
+    {
+        auto config = make_test_config();
+        config.in_process_preprocessing(in_process);
+
+        cpp_entity_index idx;
+        libclang_parser  p(default_logger());
+        auto             file = p.parse(idx, "dependencies.cpp", config);
+        REQUIRE(file);
+        // the indirect include as well as the direct one
+        REQUIRE(has(*file, "dependencies_outer.hpp"));
+        REQUIRE(has(*file, "dependencies_inner.hpp"));
+        REQUIRE(!has(*file, "dependencies.cpp"));
+    }
+}
+
+TEST_CASE("macro generated entities")
+{
+    write_file("macro_generated.cpp", R"(
+#define DECLARE(name) struct name {};
+
+DECLARE(generated)
+
+struct written {};
+)");
+
+    struct test_logger : diagnostic_logger
+    {
+        mutable std::vector<diagnostic> warnings;
+
+        bool do_log(const char*, const diagnostic& d) const override
+        {
+            if (d.severity == severity::warning)
+                warnings.push_back(d);
+            return true;
+        }
+    };
+
+    auto names = [](const cpp_file& file) {
+        std::string result;
+        for (auto& e : file)
+            if (e.kind() == cpp_entity_kind::class_t)
+                result += e.name() + " ";
+        return result;
+    };
+
+    // external preprocessing sees the expanded declaration like any other
+    {
+        test_logger     logger;
+        auto            config = make_test_config();
+        libclang_parser p(type_safe::ref(logger));
+        config.in_process_preprocessing(false);
+        auto file = p.parse(cpp_entity_index{}, "macro_generated.cpp", config);
+        REQUIRE(file);
+        REQUIRE(names(*file) == "generated written ");
+        REQUIRE(logger.warnings.empty());
+    }
+
+    // in process it only has the tokens of the invocation, so it must say so
+    {
+        test_logger     logger;
+        auto            config = make_test_config();
+        libclang_parser p(type_safe::ref(logger));
+        config.in_process_preprocessing(true);
+        auto file = p.parse(cpp_entity_index{}, "macro_generated.cpp", config);
+        REQUIRE(file);
+        REQUIRE(logger.warnings.size() == 1u);
+        REQUIRE(logger.warnings[0].location.line.value() == 4u);
+        REQUIRE(names(*file).find("written") != std::string::npos);
+    }
+}
@@ -0,0 +1,167 @@
+#include "file_watcher.h"
+#include "cpp_parser.h" // for resolvePath()
+
+#include <algorithm>
+#include <thread>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#    include <poll.h>
+#    include <sys/inotify.h>
+#endif
+
+namespace {
+
+// Changes usually come in bursts; a save touches the file more than once,
+// and a checkout touches many files
+constexpr int settleMs = 50;
+constexpr auto pollInterval = std::chrono::milliseconds(250);
+
+std::string directoryOf(std::string const& path)
+{
+    auto slash = path.rfind('/');
+    if (slash == std::string::npos)
+        return ".";
+    return slash == 0 ? "/" : path.substr(0, slash);
+}
+
+} // namespace
+
+FileWatcher::FileWatcher()
+{
+#ifdef __linux__
+    fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+}
+
+FileWatcher::~FileWatcher()
+{
+    if (fd_ >= 0)
+        close(fd_);
+}
+
+FileWatcher::Stamp FileWatcher::stamp(std::string const& path)
+{
+    Stamp s;
+    struct stat sb;
+    if (stat(path.c_str(), &sb) == 0) {
+#ifdef __linux__
+        s.mtime = sb.st_mtim.tv_sec * 1000000000LL + sb.st_mtim.tv_nsec;
+#else
+        s.mtime = sb.st_mtime;
+#endif
+        s.size = sb.st_size;
+    }
+    return s;
+}
+
+void FileWatcher::watch(std::string const& path)
+{
+    auto canonical = resolvePath(path.c_str());
+    if (canonical.empty())
+        return; // Does not exist (yet)
+    if (!files_.emplace(canonical, path).second)
+        return;
+
+    if (fd_ < 0) {
+        stamps_[canonical] = stamp(canonical);
+        return;
+    }
+
+#ifdef __linux__
+    auto dir = directoryOf(canonical);
+    if (watchedDirs_.count(dir) > 0)
+        return;
+    int wd = inotify_add_watch(fd_, dir.c_str(),
+                               IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE |
+                                   IN_DELETE | IN_ATTRIB);
+    if (wd >= 0) {
+        dirs_[wd] = dir;
+        watchedDirs_.insert(dir);
+    } else
+        stamps_[canonical] = stamp(canonical);
+#endif
+}
+
+std::vector<std::string> FileWatcher::readEvents(int timeoutMs)
+{
+    std::vector<std::string> changed;
+#ifdef __linux__
+    struct pollfd pfd = {fd_, POLLIN, 0};
+    if (::poll(&pfd, 1, timeoutMs) <= 0)
+        return changed;
+
+    alignas(struct inotify_event) char buffer[4096];
+    ssize_t len;
+    while ((len = read(fd_, buffer, sizeof(buffer))) > 0) {
+        for (char* ptr = buffer; ptr < buffer + len;) {
+            auto* event = reinterpret_cast<struct inotify_event*>(ptr);
+            ptr += sizeof(struct inotify_event) + event->len;
+            auto dir = dirs_.find(event->wd);
+            if (dir == dirs_.end() || event->len == 0)
+                continue;
+            auto it = files_.find(dir->second + "/" + event->name);
+            if (it != files_.end())
+                changed.push_back(it->second);
+        }
+    }
+#else
+    (void)timeoutMs;
+#endif
+    return changed;
+}
+
+std::vector<std::string> FileWatcher::poll(std::chrono::milliseconds timeout)
+{
+    std::vector<std::string> changed;
+    auto end = std::chrono::steady_clock::now() + timeout;
+    while (true) {
+        for (auto& entry : stamps_) {
+            auto now = stamp(entry.first);
+            if (now.mtime != entry.second.mtime ||
+                now.size != entry.second.size) {
+                entry.second = now;
+                changed.push_back(files_[entry.first]);
+            }
+        }
+        if (!changed.empty() || std::chrono::steady_clock::now() >= end)
+            return changed;
+        std::this_thread::sleep_for(pollInterval);
+    }
+}
+
+std::vector<std::string> FileWatcher::wait(std::chrono::milliseconds timeout)
+{
+    std::vector<std::string> changed;
+    if (fd_ >= 0) {
+        // Files in directories we could not watch are still polled
+        auto ms = static_cast<int>(
+            stamps_.empty() ? timeout.count()
+                            : std::min(timeout, pollInterval).count());
+        changed = readEvents(ms);
+        for (auto const& f : poll(std::chrono::milliseconds(0)))
+            changed.push_back(f);
+        // Collect the rest of the burst
+        if (!changed.empty()) {
+            std::vector<std::string> more;
+            while (!(more = readEvents(settleMs)).empty())
+                changed.insert(changed.end(), more.begin(), more.end());
+        }
+    } else {
+        changed = poll(timeout);
+        if (!changed.empty()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(settleMs));
+            for (auto const& f : poll(std::chrono::milliseconds(0)))
+                changed.push_back(f);
+        }
+    }
+
+    std::unordered_set<std::string> seen;
+    std::vector<std::string> result;
+    for (auto& f : changed)
+        if (seen.insert(f).second)
+            result.push_back(std::move(f));
+    return result;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Reports watched files that changed on disk.
+// Uses inotify on Linux, and falls back to comparing modification times
+// when that is not available.
+// Directories are watched rather than files, so editors that save by
+// writing a new file and renaming it are still seen.
+class FileWatcher
+{
+public:
+    FileWatcher();
+    ~FileWatcher();
+    FileWatcher(FileWatcher const&) = delete;
+    FileWatcher& operator=(FileWatcher const&) = delete;
+
+    // Start watching `path`. Watching a file twice is harmless.
+    void watch(std::string const& path);
+
+    // Wait until watched files change, and return them as they were given
+    // to `watch()`. Returns an empty list if nothing changed within
+    // `timeout`.
+    std::vector<std::string> wait(std::chrono::milliseconds timeout);
+
+    bool usesInotify() const { return fd_ >= 0; }
+
+private:
+    struct Stamp
+    {
+        long long mtime = 0;
+        long long size = -1;
+    };
+
+    std::vector<std::string> readEvents(int timeoutMs);
+    std::vector<std::string> poll(std::chrono::milliseconds timeout);
+    static Stamp stamp(std::string const& path);
+
+    int fd_ = -1;
+    // Watch descriptor to directory
+    std::unordered_map<int, std::string> dirs_;
+    std::unordered_set<std::string> watchedDirs_;
+    // Canonical path to the path given to `watch()`
+    std::unordered_map<std::string, std::string> files_;
+    // Only used when polling
+    std::unordered_map<std::string, Stamp> stamps_;
+};
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+constexpr uint64_t fnvBasis = 14695981039346656037ull;
+constexpr uint64_t fnvPrime = 1099511628211ull;
+
+// FNV-1a, same as cppast uses for entity ids
+inline uint64_t hash(const char* data, size_t size, uint64_t h = fnvBasis)
+{
+    for (size_t i = 0; i < size; i++)
+        h = (h ^ static_cast<uint8_t>(data[i])) * fnvPrime;
+    return h;
+}
+
+inline uint64_t hash(std::string const& s, uint64_t h = fnvBasis)
+{
+    // Include the terminator so "ab","c" and "a","bc" differ
+    return hash(s.c_str(), s.size() + 1, h);
+}
@@ -0,0 +1,229 @@
+#include "lua_template.h"
+#include "hash.h"
+#include "template_tokenizer.h"
+
+#include <coreutils/file.h>
+#include <coreutils/mapped_file.h>
+#include <coreutils/path.h>
+
+#include <fmt/format.h>
+
+#include <lua.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+
+#include <unistd.h>
+
+namespace {
+
+// Bump when the generated code changes
+constexpr uint32_t compilerVersion = 2;
+
+bool isIdentifier(char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+           (c >= '0' && c <= '9') || c == '_';
+}
+
+size_t skipSpace(std::string_view code, size_t pos)
+{
+    while (pos < code.size() && (code[pos] == ' ' || code[pos] == '\t' ||
+                                 code[pos] == '\n' || code[pos] == '\r'))
+        pos++;
+    return pos;
+}
+
+// Length of the long bracket (`[[`, `[==[` ...) at `pos`, or 0
+size_t longBracket(std::string_view code, size_t pos, size_t& level)
+{
+    if (pos >= code.size() || code[pos] != '[')
+        return 0;
+    auto i = pos + 1;
+    while (i < code.size() && code[i] == '=')
+        i++;
+    if (i >= code.size() || code[i] != '[')
+        return 0;
+    level = i - pos - 1;
+    return i - pos + 1;
+}
+
+// Position after the long string or comment at `pos`
+size_t skipLong(std::string_view code, size_t pos, size_t level, size_t len)
+{
+    auto close = "]" + std::string(level, '=') + "]";
+    auto end = code.find(close, pos + len);
+    return end == std::string_view::npos ? code.size() : end + close.size();
+}
+
+// Read the string literal at `pos` into `value`. Returns the position after
+// it, or npos if there is no plain literal there.
+size_t readLiteral(std::string_view code, size_t pos, std::string& value)
+{
+    if (pos >= code.size())
+        return std::string_view::npos;
+    char quote = code[pos];
+    size_t level;
+    if (auto len = longBracket(code, pos, level)) {
+        auto end = skipLong(code, pos, level, len);
+        auto close = level + 2;
+        if (end - pos < len + close)
+            return std::string_view::npos;
+        value = std::string(code.substr(pos + len, end - pos - len - close));
+        return end;
+    }
+    if (quote != '"' && quote != '\'')
+        return std::string_view::npos;
+    auto end = code.find(quote, pos + 1);
+    auto text = code.substr(pos + 1, end - pos - 1);
+    // Escapes are rare in names; do not bother decoding them
+    if (end == std::string_view::npos ||
+        text.find_first_of("\\\n") != std::string_view::npos)
+        return std::string_view::npos;
+    value = std::string(text);
+    return end + 1;
+}
+
+// Find calls to the functions that bring in sources and symbols in one
+// code segment
+void scanCode(std::string_view code, TemplateReferences& refs)
+{
+    size_t pos = 0;
+    while (pos < code.size()) {
+        char c = code[pos];
+        size_t level;
+        if (c == '-' && code.compare(pos, 2, "--") == 0) {
+            pos += 2;
+            if (auto len = longBracket(code, pos, level))
+                pos = skipLong(code, pos, level, len);
+            else {
+                auto end = code.find('\n', pos);
+                pos = end == std::string_view::npos ? code.size() : end;
+            }
+        } else if (c == '"' || c == '\'') {
+            for (pos++; pos < code.size() && code[pos] != c; pos++)
+                if (code[pos] == '\\')
+                    pos++;
+            pos++;
+        } else if (auto len = longBracket(code, pos, level)) {
+            pos = skipLong(code, pos, level, len);
+        } else if (isIdentifier(c)) {
+            auto start = pos;
+            while (pos < code.size() && isIdentifier(code[pos]))
+                pos++;
+            // Fields and methods of something else, like `t.class`
+            bool member = start > 0 && (code[start - 1] == '.' ||
+                                        code[start - 1] == ':');
+            auto name = code.substr(start, pos - start);
+            bool isSource = name == "source";
+            if (member || !(isSource || name == "symbol" || name == "class" ||
+                            name == "doc_comment"))
+                continue;
+
+            auto arg = skipSpace(code, pos);
+            bool paren = arg < code.size() && code[arg] == '(';
+            if (paren)
+                arg = skipSpace(code, arg + 1);
+            // `doc_comment()` is about the current symbol
+            if (paren && arg < code.size() && code[arg] == ')')
+                continue;
+            std::string value;
+            auto end = readLiteral(code, arg, value);
+            if (end != std::string_view::npos && paren) {
+                end = skipSpace(code, end);
+                if (end >= code.size() || (code[end] != ')' && code[end] != ','))
+                    end = std::string_view::npos;
+            }
+            if (end == std::string_view::npos) {
+                // Not a literal; `source()` only matters for prefetching,
+                // but any symbol could be asked for
+                if (!isSource)
+                    refs.dynamic = true;
+                continue;
+            }
+            (isSource ? refs.sources : refs.symbols).push_back(value);
+            pos = end;
+        } else {
+            pos++;
+        }
+    }
+}
+
+} // namespace
+
+std::string compileTemplate(std::string_view doc)
+{
+    // A local is much faster to call than a global
+    std::string chunk = "local __emit = ...;";
+    TemplateTokenizer tokenizer(doc);
+    Segment segment;
+    while (tokenizer.next(segment)) {
+        if (segment.kind == Segment::Code) {
+            chunk.append(segment.text.data(), segment.text.size());
+            // Ends a statement without adding a line
+            chunk += " ;";
+        } else {
+            chunk += fmt::format("__emit({},{});",
+                                 segment.text.data() - doc.data(),
+                                 segment.text.size());
+            chunk.append(static_cast<size_t>(std::count(
+                             segment.text.begin(), segment.text.end(), '\n')),
+                         '\n');
+        }
+    }
+    return chunk;
+}
+
+TemplateReferences findReferences(std::string_view doc)
+{
+    TemplateReferences refs;
+    TemplateTokenizer tokenizer(doc);
+    Segment segment;
+    while (tokenizer.next(segment))
+        if (segment.kind == Segment::Code)
+            scanCode(segment.text, refs);
+    return refs;
+}
+
+TemplateCache::TemplateCache(std::string const& dir) : dir_(dir)
+{
+    if (!utils::exists(dir_))
+        utils::create_directory(dir_);
+}
+
+std::string TemplateCache::entryName(uint64_t key) const
+{
+    return fmt::format("{}/{:016x}.luac", dir_, key);
+}
+
+uint64_t TemplateCache::key(std::string const& name, std::string_view doc)
+{
+    uint32_t version[] = {compilerVersion, LUA_VERSION_NUM};
+    uint64_t h = hash(reinterpret_cast<const char*>(version), sizeof(version));
+    // The name ends up in error messages
+    h = hash(name, h);
+    return hash(doc.data(), doc.size(), h);
+}
+
+bool TemplateCache::load(uint64_t key, std::string& bytecode) const
+{
+    utils::MappedFile m;
+    if (!m.open(entryName(key)) || m.empty())
+        return false;
+    bytecode.assign(m.data(), m.size());
+    return true;
+}
+
+void TemplateCache::store(uint64_t key, std::string const& bytecode) const
+{
+    static std::atomic<unsigned> counter{0};
+    auto name = entryName(key);
+    auto tmp = fmt::format("{}.{}.{}", name, getpid(), counter++);
+    {
+        utils::File f{tmp, utils::File::Write};
+        f.writeString(bytecode);
+    }
+    if (std::rename(tmp.c_str(), name.c_str()) != 0)
+        std::remove(tmp.c_str());
+}
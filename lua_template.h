@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Turn a whole template into the source of one Lua chunk, so loops and
+// conditions can span text. Text becomes calls to `emit(offset, size)`,
+// the first argument of the chunk, with offsets into `doc`; code is copied
+// as is. Line numbers in the chunk match those in the template.
+std::string compileTemplate(std::string_view doc);
+
+// What a template refers to, found without running it
+struct TemplateReferences
+{
+    // Literal arguments of `source()`
+    std::vector<std::string> sources;
+    // Literal arguments of `symbol()`, `class()` and `doc_comment()`
+    std::vector<std::string> symbols;
+    // Set if one of those is called with something other than a literal,
+    // so any symbol may be used
+    bool dynamic = false;
+};
+
+TemplateReferences findReferences(std::string_view doc);
+
+// On-disk cache of compiled templates, as Lua bytecode
+class TemplateCache
+{
+public:
+    explicit TemplateCache(std::string const& dir);
+
+    static uint64_t key(std::string const& name, std::string_view doc);
+
+    bool load(uint64_t key, std::string& bytecode) const;
+    void store(uint64_t key, std::string const& bytecode) const;
+
+private:
+    std::string entryName(uint64_t key) const;
+    std::string dir_;
+};
@@ -1,56 +1,38 @@
+#include "cpp_parser.h"
+#include "file_watcher.h"
+#include "lua_template.h"
+#include "memory_budget.h"
+#include "renderer.h"
+#include "template_tokenizer.h"
+#include "trace.h"
+
 #include <coreutils/file.h>
+#include <coreutils/mapped_file.h>
+#include <coreutils/output_buffer.h>
 #include <coreutils/utils.h>
 
 #include <fmt/format.h>
-#include <sol2/sol.hpp>
 
-#include <cppast/code_generator.hpp>  // for generate_code()
-#include <cppast/cpp_entity_kind.hpp> // for the cpp_entity_kind definition
-#include <cppast/cpp_forward_declarable.hpp> // for is_definition()
-#include <cppast/cpp_namespace.hpp>          // for cpp_namespace
-#include <cppast/libclang_parser.hpp> // for libclang_parser, libclang_compile_config, cpp_entity,...
-#include <cppast/visitor.hpp> // for visit()
+#include <CLI/CLI.hpp>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cstdint>
 #include <cstdlib>
 #include <iostream>
+#include <memory>
+#include <optional>
+#include <stdexcept>
 #include <string>
+#include <string_view>
 #include <thread>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
 using namespace std::string_literals;
 
-struct parser_exception : public std::exception
-{
-    parser_exception(std::string const& msg) : message(msg) {}
-    std::string message;
-};
-
-#ifdef __unix__
-#    include <limits.h>
-#    include <stdlib.h>
-#endif
-
-std::string resolvePath(const char* path)
-{
-    std::string resolvedPath;
-
-#ifdef __unix__
-    char* resolvedPathRaw = new char[PATH_MAX];
-    char* result = realpath(path, resolvedPathRaw);
-
-    if (result)
-        resolvedPath = resolvedPathRaw;
-
-    delete[] resolvedPathRaw;
-#else
-    resolvedPath = path;
-#endif
-
-    return resolvedPath;
-}
-
 namespace hey {
 
 struct SomeType
@@ -70,224 +52,344 @@ public:
 };
 } // namespace hey
 
-std::vector<std::string> parse(std::string const& doc)
+// Render a template to `outFile`, or stdout if it is empty. Returns the
+// source files it used, so it can be rendered again when one of them changes.
+std::unordered_set<std::string> render(CppParser& parser, RendererPool& pool,
+                                       TemplateCache const* cache,
+                                       std::string const& templateFile,
+                                       std::string const& outFile)
 {
-    std::string output;
-    std::vector<std::string> segments;
-    int inQuotes = 0;
-    int curly = 0;
-    int lastChar = 0;
-    for (auto c : doc) {
-        if (inQuotes) {
-            if (c == inQuotes && lastChar != '\\')
-                inQuotes = 0;
-        } else if (curly > 0) {
-            if (c == '}') {
-                if (lastChar == '@')
-                    curly = 1;
-                curly--;
-                if (curly == 0) {
-                    segments.push_back(output);
-                    output = "";
-                    continue;
-                }
-            } else if (c == '{')
-                curly++;
-            else if (c == '\'' || c == '\"') {
-                inQuotes = c;
-            }
-        } else {
-            if (c == '{' && lastChar == '@') {
-                curly = 1;
-                segments.push_back(output.substr(0, output.length() - 1));
-                output = "";
-                continue;
-            }
-        }
-        output += c;
-        lastChar = c;
-    }
-    return segments;
+    // Text is copied straight from the mapping to the output
+    utils::MappedFile mapped(templateFile);
+
+    trace::Scope scope("render", templateFile);
+    auto out = outFile.empty()
+                   ? std::make_unique<utils::OutputBuffer>(stdout)
+                   : std::make_unique<utils::OutputBuffer>(outFile);
+    auto used = pool.acquire()->render(parser, templateFile, mapped.view(),
+                                       *out, cache);
+    out->flush();
+    return used;
 }
 
-struct Var
-{
-    std::string name;
-    std::string type;
-};
-
-struct Method
+// One document of a batch
+struct BatchDocument
 {
-    std::string name;
-    std::vector<Var> params;
+    std::string templateFile;
+    std::string outFile;
 };
 
-struct Class
+// Read a batch manifest. Every line names a template and the file to render
+// it to, separated by spaces; paths are relative to the manifest. Empty
+// lines and lines starting with '#' are skipped.
+std::vector<BatchDocument> readManifest(std::string const& manifest)
 {
-    Class() = default;
-    Class(std::string const& ns, std::string const& name) : name(name), ns(ns)
-    {}
-    std::string name;
-    std::string ns;
-    std::vector<Method> methods;
-    std::vector<Var> fields;
-};
+    auto slash = manifest.rfind('/');
+    auto dir = slash == std::string::npos ? ""s : manifest.substr(0, slash + 1);
+    auto relative = [&](std::string_view name) {
+        return name[0] == '/' ? std::string(name) : dir + std::string(name);
+    };
+
+    std::vector<BatchDocument> documents;
+    std::unordered_set<std::string> outFiles;
+    utils::MappedFile mapped(manifest);
+    size_t lineNo = 0;
+    for (auto line : mapped.lines()) {
+        lineNo++;
+        std::vector<std::string_view> fields;
+        for (auto field : utils::StringViewSplit(line, " "))
+            if (!field.empty())
+                fields.push_back(field);
+        if (fields.empty() || fields[0][0] == '#')
+            continue;
+        if (fields.size() != 2)
+            throw std::runtime_error(
+                fmt::format("{}:{}: Expected '<template> <output>'", manifest,
+                            lineNo));
+        BatchDocument doc{relative(fields[0]), relative(fields[1])};
+        // Two documents writing one file would race
+        if (!outFiles.insert(doc.outFile).second)
+            throw std::runtime_error(fmt::format(
+                "{}:{}: {} is written twice", manifest, lineNo, doc.outFile));
+        documents.push_back(std::move(doc));
+    }
+    return documents;
+}
 
-// prints the AST entry of a cpp_entity (base class for all entities),
-// will only print a single line
-void print_entity(std::ostream& out, const cppast::cpp_entity& e)
+// Render every document on `threads` workers (0 means one per core), each
+// with its own Lua state and output, sharing the frozen parser. Errors are
+// reported in manifest order, whichever document finishes first. Returns
+// the number of documents that failed.
+size_t renderBatch(CppParser& parser, TemplateCache const* cache,
+                   std::vector<BatchDocument> const& documents,
+                   unsigned threads)
 {
-    // print name and the kind of the entity
-    if (!e.name().empty())
-        out << e.name();
-    else
-        out << "<anonymous>";
-    out << " (" << cppast::to_string(e.kind()) << ")";
-
-    // print whether or not it is a definition
-    if (cppast::is_definition(e))
-        out << " [definition]";
-
-    // print number of attributes
-    if (!e.attributes().empty())
-        out << " [" << e.attributes().size() << " attribute(s)]";
-
-    if (e.kind() == cppast::cpp_entity_kind::language_linkage_t)
-        // no need to print additional information for language linkages
-        out << '\n';
-    else if (e.kind() == cppast::cpp_entity_kind::namespace_t) {
-        // cast to cpp_namespace
-        auto& ns = static_cast<const cppast::cpp_namespace&>(e);
-        // print whether or not it is inline
-        if (ns.is_inline())
-            out << " [inline]";
-        out << '\n';
-    } else {
-        // print the declaration of the entity
-        // it will only use a single line
-        // derive from code_generator and implement various callbacks for
-        // printing it will print into a std::string
-        class code_generator : public cppast::code_generator
-        {
-            std::string str_; // the result
-            bool was_newline_ =
-                false; // whether or not the last token was a newline
-            // needed for lazily printing them
-
-        public:
-            code_generator(const cppast::cpp_entity& e)
-            {
-                // kickoff code generation here
-                cppast::generate_code(*this, e);
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = static_cast<unsigned>(
+        std::min<size_t>(threads, std::max<size_t>(documents.size(), 1)));
+    RendererPool pool(threads);
+
+    std::vector<std::optional<std::string>> errors(documents.size());
+    std::atomic<size_t> next{0};
+    auto work = [&] {
+        for (size_t i = next++; i < documents.size(); i = next++) {
+            try {
+                render(parser, pool, cache, documents[i].templateFile,
+                       documents[i].outFile);
+            } catch (std::exception const& e) {
+                errors[i] = e.what();
             }
-
-            // return the result
-            const std::string& str() const noexcept { return str_; }
-
-        private:
-            // called to retrieve the generation options of an entity
-            generation_options
-            do_get_options(const cppast::cpp_entity&,
-                           cppast::cpp_access_specifier_kind) override
-            {
-                // generate declaration only
-                return code_generator::declaration;
-            }
-
-            // no need to handle indentation, as only a single line is used
-            void do_indent() override {}
-            void do_unindent() override {}
-
-            // called when a generic token sequence should be generated
-            // there are specialized callbacks for various token kinds,
-            // to e.g. implement syntax highlighting
-            void do_write_token_seq(cppast::string_view tokens) override
-            {
-                if (was_newline_) {
-                    // lazily append newline as space
-                    str_ += ' ';
-                    was_newline_ = false;
-                }
-                // append tokens
-                str_ += tokens.c_str();
-            }
-
-            // called when a newline should be generated
-            // we're lazy as it will always generate a trailing newline,
-            // we don't want
-            void do_write_newline() override { was_newline_ = true; }
-
-        } generator(e);
-        // print generated code
-        out << ": `" << generator.str() << '`' << '\n';
+        }
+    };
+    std::vector<std::thread> workers;
+    for (unsigned i = 1; i < threads; i++)
+        workers.emplace_back(work);
+    work();
+    for (auto& worker : workers)
+        worker.join();
+
+    size_t failed = 0;
+    for (auto const& error : errors) {
+        if (error) {
+            fmt::print(stderr, "{}\n", *error);
+            failed++;
+        }
     }
+    if (failed > 0)
+        fmt::print(stderr, "{} of {} documents failed\n", failed,
+                   documents.size());
+    return failed;
 }
-class CppParser
-{
-    std::string project_dir_;
-    std::unordered_map<std::string, Class> classes;
-    std::vector<std::string> ns;
-    std::string className;
-    cppast::libclang_compilation_database database_;
-
-public:
-    CppParser(std::string const& project_dir)
-        : project_dir_(project_dir), database_(project_dir)
-    {}
 
-    void load(std::string const& source_file)
-    {
-        std::cout << source_file << "\n";
-        auto resolvedPath = resolvePath(source_file.c_str());
-        auto config = cppast::libclang_compile_config(database_, resolvedPath);
-        cppast::stderr_diagnostic_logger logger;
-        logger.set_verbose(true);
-
-        // Index is used to resolve cross references in the AST
-        // we don't need that, so it will not be needed afterwards
-        cppast::cpp_entity_index idx;
-        // the parser is used to parse the entity
-        // there can be multiple parser implementations
-        cppast::libclang_parser parser(type_safe::ref(logger));
-        // parse the file
-        auto file = parser.parse(idx, resolvedPath, config);
-        if (parser.error())
-            throw parser_exception("Could not parse");
-        cppast::visit(
-            *file, [&](const cppast::cpp_entity& e, cppast::visitor_info info) {
-                if (e.kind() == cppast::cpp_entity_kind::class_t) {
-                    fmt::print("{} : {}\n", e.name(), info.event);
-                }
-                print_entity(std::cout, e);
-                return true;
-            });
+// Render again whenever the template, or a source file it used, changes
+void watch(CppParser& parser, RendererPool& pool, TemplateCache const* cache,
+           std::string const& templateFile, std::string const& outFile,
+           std::unordered_set<std::string> used, bool failed)
+{
+    auto templatePath = resolvePath(templateFile.c_str());
+    FileWatcher watcher;
+    auto watchAll = [&] {
+        watcher.watch(templatePath);
+        for (auto const& file : parser.files())
+            watcher.watch(file);
+    };
+    watchAll();
+    fmt::print(stderr, "Watching for changes ({})\n",
+               watcher.usesInotify() ? "inotify" : "polling");
+
+    while (true) {
+        auto changed = watcher.wait(std::chrono::seconds(1));
+        if (changed.empty())
+            continue;
+
+        auto start = std::chrono::steady_clock::now();
+        auto updated = parser.update(changed);
+        bool again = failed;
+        for (auto const& file : changed)
+            again = again || resolvePath(file.c_str()) == templatePath;
+        for (auto const& file : updated)
+            again = again || used.count(file) > 0;
+
+        if (again) {
+            try {
+                used = render(parser, pool, cache, templateFile, outFile);
+                failed = false;
+            } catch (std::exception const& e) {
+                fmt::print(stderr, "{}\n", e.what());
+                failed = true;
+            }
+        }
+        // Files that were used for the first time
+        watchAll();
+
+        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                      std::chrono::steady_clock::now() - start)
+                      .count();
+        fmt::print(stderr, "{} changed, {} parsed, {} in {} ms\n",
+                   changed.size(), updated.size(),
+                   again ? "rendered" : "not rendered", ms);
+        // One file per cycle, so the events do not pile up
+        if (trace::enabled())
+            trace::rotate();
     }
-
-    void test1(size_t abc) {}
-
-    void test2(std::thread const& cde) {}
-    void test3(std::vector<int> const& fgh) {}
-};
+}
 
 int main(int argc, char** argv)
 {
+    CLI::App app{"dox"};
+    std::string infile;
+    std::string outfile;
+    std::string projectDir;
+    std::string cacheDir;
+    bool noCache = false;
+    bool verbose = false;
+    bool inProcessPreprocessor = false;
+    std::vector<std::string> precompiled;
+    bool watchMode = false;
+    bool parseAll = false;
+    bool commentsOnly = false;
+    bool stream = false;
+    size_t maxMemory = 0;
+    std::string traceFile;
+    std::string batchFile;
+    unsigned jobs = 0;
+    auto* infileOption = app.add_option("infile", infile, "Template file");
+    app.add_option("-o,--output", outfile,
+                   "Write the result here instead of to stdout");
+    app.add_option("--project", projectDir,
+                   "Parse every translation unit in the compilation "
+                   "database of this build directory");
+    app.add_option("-j,--jobs", jobs,
+                   "Number of parser and renderer threads (default: one "
+                   "per core)");
+    app.add_option("--cache-dir", cacheDir,
+                   "Where to keep parsed models between runs "
+                   "(default: <project>/.dox-cache)");
+    app.add_flag("--no-cache", noCache, "Always parse every file");
+    app.add_flag("-v,--verbose", verbose, "Dump the parsed AST to stderr");
+    app.add_flag("--in-process-preprocessor", inProcessPreprocessor,
+                 "Preprocess inside libclang instead of running clang -E; "
+                 "faster, but misses classes that are generated by macros");
+    app.add_option("--pch", precompiled,
+                   "Precompile this header once and reuse it for every file, "
+                   "e.g. --pch vector --pch string");
+    app.add_flag("--parse-all", parseAll,
+                 "Convert every entity, not only the symbols the template "
+                 "refers to");
+    app.add_flag("--comments-only", commentsOnly,
+                 "Read classes and doc comments without parsing, for the "
+                 "files where that gives the same result; the rest are "
+                 "parsed as usual");
+    app.add_flag("--stream", stream,
+                 "Free the AST of every file as soon as it is distilled, and "
+                 "report the peak memory use");
+    app.add_option("--max-memory", maxMemory,
+                   "Hold back parsing while dox uses more than this many MiB; "
+                   "implies --stream");
+    app.add_option("--trace", traceFile,
+                   "Write a timeline of every phase, per file, with "
+                   "allocation counts, as Chrome trace JSON");
+    auto* watchOption =
+        app.add_flag("-w,--watch", watchMode,
+                     "Keep running, and render again when the template or "
+                     "the sources it uses change");
+    app.add_option("--batch", batchFile,
+                   "Parse once, then render every template listed in this "
+                   "manifest, one '<template> <output>' per line, in "
+                   "parallel")
+        ->excludes(infileOption)
+        ->excludes(watchOption);
+    CLI11_PARSE(app, argc, argv);
+    if (infile.empty() && batchFile.empty()) {
+        fmt::print(stderr, "A template or --batch is required\n");
+        return 1;
+    }
 
-    CppParser parser{"."};
-    parser.load(argv[1]);
-
-    sol::state lua;
+    if (!traceFile.empty())
+        trace::start(traceFile);
+
+    if (projectDir.empty())
+        projectDir = ".";
+    if (cacheDir.empty())
+        cacheDir = projectDir + "/.dox-cache";
+
+    CppParser parser{projectDir};
+    parser.setVerbose(verbose);
+    parser.setInProcessPreprocessor(inProcessPreprocessor);
+    for (auto const& header : precompiled)
+        parser.addPrecompiledHeader(header);
+    parser.setIncremental(watchMode);
+    parser.setScanComments(commentsOnly);
+    stream = stream || maxMemory > 0;
+    parser.setStreaming(stream, maxMemory << 20);
+    if (!noCache)
+        parser.setCacheDir(cacheDir);
+
+    std::vector<BatchDocument> documents;
+    if (!batchFile.empty()) {
+        try {
+            documents = readManifest(batchFile);
+        } catch (std::exception const& e) {
+            fmt::print(stderr, "{}\n", e.what());
+            return 1;
+        }
+    } else
+        documents.push_back({infile, outfile});
+
+    // Only convert what the templates ask for; anything else a single
+    // template turns out to need is parsed when it is asked for
+    TemplateReferences references;
+    for (auto const& doc : documents) {
+        utils::MappedFile mapped;
+        try {
+            trace::Scope scope("references", doc.templateFile);
+            if (!mapped.open(doc.templateFile))
+                continue;
+            auto found = findReferences(mapped.view());
+            references.sources.insert(references.sources.end(),
+                                      found.sources.begin(),
+                                      found.sources.end());
+            references.symbols.insert(references.symbols.end(),
+                                      found.symbols.begin(),
+                                      found.symbols.end());
+            references.dynamic = references.dynamic || found.dynamic;
+        } catch (template_error const&) {
+            // Reported when rendering
+        }
+    }
+    if (!parseAll && !references.dynamic)
+        parser.setWanted(references.symbols);
+    {
+        trace::Scope scope("load");
+        if (app.count("--project") > 0)
+            parser.loadProject(jobs);
+        else
+            parser.loadFiles(references.sources, jobs);
+    }
+    if (stream)
+        fmt::print(stderr, "Peak memory use after parsing: {} MiB\n",
+                   MemoryBudget::peakRss() >> 20);
+
+    std::unique_ptr<TemplateCache> templates;
+    if (!noCache)
+        templates = std::make_unique<TemplateCache>(cacheDir);
+
+    if (!batchFile.empty()) {
+        // Nothing may be parsed while the documents render, so parse what
+        // loadFiles() skipped now
+        for (auto const& source : references.sources) {
+            try {
+                parser.load(source);
+            } catch (std::exception const& e) {
+                fmt::print(stderr, "{}: {}\n", source, e.what());
+            }
+        }
+        parser.freeze();
+        auto failed = renderBatch(parser, templates.get(), documents, jobs);
+        if (trace::enabled())
+            trace::write();
+        return failed > 0 ? 1 : 0;
+    }
 
-    lua["print"] = [](std::string const& text) { std::cout << text; };
+    RendererPool pool;
 
-    auto res = parse(utils::File{argv[1]}.readAll());
-    bool isLua = false;
-    for (auto segment : res) {
-        if (isLua) {
-            lua.script(segment);
-        } else
-            fmt::print("{}", segment);
-        isLua = !isLua;
+    std::unordered_set<std::string> used;
+    bool failed = false;
+    try {
+        used = render(parser, pool, templates.get(), infile, outfile);
+    } catch (std::exception const& e) {
+        fmt::print(stderr, "{}\n", e.what());
+        failed = true;
+    }
+    if (!watchMode) {
+        if (trace::enabled())
+            trace::write();
+        return failed ? 1 : 0;
     }
+    if (trace::enabled())
+        trace::rotate();
+    watch(parser, pool, templates.get(), infile, outfile, used, failed);
 
 #if 0
     CXIndex index = clang_createIndex(0, 0);
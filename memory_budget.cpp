@@ -0,0 +1,63 @@
+#include "memory_budget.h"
+
+#include <chrono>
+#include <cstdio>
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+#ifdef __GLIBC__
+#    include <malloc.h>
+#endif
+
+size_t MemoryBudget::currentRss()
+{
+#ifdef __linux__
+    // Pages: total size, then resident
+    if (auto* f = fopen("/proc/self/statm", "r")) {
+        unsigned long size = 0;
+        unsigned long resident = 0;
+        int n = fscanf(f, "%lu %lu", &size, &resident);
+        fclose(f);
+        if (n == 2)
+            return resident * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    }
+#endif
+    // Can not do better than the peak
+    return peakRss();
+}
+
+size_t MemoryBudget::peakRss()
+{
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return static_cast<size_t>(usage.ru_maxrss);
+#else
+    // In kilobytes everywhere else
+    return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+}
+
+void MemoryBudget::acquire()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    // Memory is also freed outside of jobs, so look again now and then
+    // instead of only when a job is done
+    while (limit_ > 0 && running_ > 0 && currentRss() > limit_)
+        done_.wait_for(lock, std::chrono::milliseconds(50));
+    running_++;
+}
+
+void MemoryBudget::release()
+{
+#ifdef __GLIBC__
+    // Otherwise freed memory stays resident, and would keep holding back
+    // jobs that would fit. Not needed while there is room anyway.
+    if (limit_ > 0 && currentRss() > limit_)
+        malloc_trim(0);
+#endif
+    std::lock_guard<std::mutex> lock(mutex_);
+    running_--;
+    done_.notify_all();
+}
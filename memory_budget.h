@@ -0,0 +1,48 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+
+// Holds back new jobs while the process uses more memory than a limit.
+// Jobs that are already running are never interrupted, and one job may always
+// run, so a single file larger than the limit still gets parsed.
+class MemoryBudget
+{
+public:
+    // `limit` is in bytes; 0 means no limit
+    explicit MemoryBudget(size_t limit = 0) : limit_(limit) {}
+
+    // Wait until there is room, then count a job as running
+    void acquire();
+    // The job is done, and what it allocated is freed
+    void release();
+
+    size_t limit() const { return limit_; }
+
+    // Resident memory of the process right now, and the most it has used
+    static size_t currentRss();
+    static size_t peakRss();
+
+    // A job that lasts as long as the scope
+    class Scope
+    {
+    public:
+        explicit Scope(MemoryBudget& budget) : budget_(budget)
+        {
+            budget_.acquire();
+        }
+        ~Scope() { budget_.release(); }
+        Scope(Scope const&) = delete;
+        Scope& operator=(Scope const&) = delete;
+
+    private:
+        MemoryBudget& budget_;
+    };
+
+private:
+    size_t limit_;
+    unsigned running_ = 0;
+    std::mutex mutex_;
+    std::condition_variable done_;
+};
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+struct Var
+{
+    std::string name;
+    std::string type;
+    std::string doc;
+};
+
+struct Method
+{
+    std::string name;
+    std::vector<Var> params;
+    std::string doc;
+};
+
+struct Class
+{
+    Class() = default;
+    Class(std::string const& ns, std::string const& name) : name(name), ns(ns)
+    {}
+    std::string name;
+    std::string ns;
+    std::vector<Method> methods;
+    std::vector<Var> fields;
+    std::string doc;
+};
+
+struct Include
+{
+    std::string path;
+    bool system = false;
+};
+
+// Everything dox needs to know about one parsed source or header file
+struct FileModel
+{
+    std::string path;
+    std::vector<Include> includes;
+    // Every file it includes, directly or not; what a cached model of it
+    // depends on
+    std::vector<std::string> dependencies;
+    std::vector<Class> classes;
+    // Parsed with an entity filter, so only some of the classes are here
+    bool partial = false;
+};
@@ -0,0 +1,283 @@
+#include "model_cache.h"
+#include "hash.h"
+
+#include <coreutils/file.h>
+#include <coreutils/mapped_file.h>
+#include <coreutils/path.h>
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <set>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr uint32_t cacheVersion = 4;
+
+bool hashFile(std::string const& path, uint64_t& result,
+              uint64_t h = fnvBasis)
+{
+    utils::MappedFile f;
+    if (!f.open(path))
+        return false;
+    result = hash(f.data(), f.size(), h);
+    return true;
+}
+
+class Writer
+{
+    std::string out;
+
+public:
+    template <typename T> void put(T t)
+    {
+        out.append(reinterpret_cast<const char*>(&t), sizeof(T));
+    }
+    void put(std::string const& s)
+    {
+        put(static_cast<uint32_t>(s.size()));
+        out += s;
+    }
+    void put(Var const& v)
+    {
+        put(v.name);
+        put(v.type);
+        put(v.doc);
+    }
+    std::string const& data() const { return out; }
+};
+
+// Bounds checked reader; a truncated or corrupt entry just sets `ok` to
+// false and is treated as a cache miss
+class Reader
+{
+    const char* ptr;
+    const char* end;
+
+public:
+    bool ok = true;
+
+    Reader(const char* data, size_t size) : ptr(data), end(data + size) {}
+
+    template <typename T> T get()
+    {
+        T t{};
+        if (end - ptr < static_cast<ptrdiff_t>(sizeof(T))) {
+            ok = false;
+            return t;
+        }
+        memcpy(&t, ptr, sizeof(T));
+        ptr += sizeof(T);
+        return t;
+    }
+    std::string getString()
+    {
+        auto size = get<uint32_t>();
+        if (!ok || static_cast<size_t>(end - ptr) < size) {
+            ok = false;
+            return {};
+        }
+        std::string s(ptr, size);
+        ptr += size;
+        return s;
+    }
+    Var getVar()
+    {
+        Var v;
+        v.name = getString();
+        v.type = getString();
+        v.doc = getString();
+        return v;
+    }
+};
+
+} // namespace
+
+ModelCache::ModelCache(std::string const& dir) : dir_(dir)
+{
+    if (!utils::exists(dir_))
+        utils::create_directory(dir_);
+}
+
+std::string ModelCache::entryName(uint64_t key) const
+{
+    return fmt::format("{}/{:016x}.dox", dir_, key);
+}
+
+void ModelCache::setFilter(std::vector<std::string> names)
+{
+    filter_ = 0;
+    if (names.empty())
+        return;
+    // The same names in any order
+    std::sort(names.begin(), names.end());
+    filter_ = fnvBasis;
+    for (auto const& name : names)
+        filter_ = hash(name, filter_);
+}
+
+bool ModelCache::key(std::string const& path,
+                     cppast::libclang_compile_config const& config,
+                     uint64_t& result) const
+{
+    using Access = cppast::detail::libclang_compile_config_access;
+    uint64_t h = hash(reinterpret_cast<const char*>(&cacheVersion),
+                      sizeof(cacheVersion));
+    h = hash(path, h);
+    for (auto const& flag : Access::flags(config))
+        h = hash(flag, h);
+    // The preprocessors do not see exactly the same entities
+    h = hash(Access::in_process_preprocessing(config) ? "in-process" : "", h);
+    h = hash(reinterpret_cast<const char*>(&filter_), sizeof(filter_), h);
+    if (!hashFile(path, h, h))
+        return false;
+    result = h;
+    return true;
+}
+
+bool ModelCache::hashOf(std::string const& path, uint64_t& result) const
+{
+    struct stat st;
+    if (::stat(path.c_str(), &st) != 0)
+        return false;
+    int64_t mtime = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 +
+                    st.st_mtim.tv_nsec;
+    int64_t size = st.st_size;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = hashes_.find(path);
+        if (it != hashes_.end() && it->second.mtime == mtime &&
+            it->second.size == size) {
+            result = it->second.hash;
+            return true;
+        }
+    }
+    if (!hashFile(path, result))
+        return false;
+    std::lock_guard<std::mutex> lock(mutex_);
+    hashes_[path] = {mtime, size, result};
+    return true;
+}
+
+bool ModelCache::load(uint64_t key, FileModel& target) const
+{
+    utils::MappedFile m;
+    if (!m.open(entryName(key)) || m.empty())
+        return false;
+
+    Reader r(m.data(), m.size());
+    if (r.get<uint32_t>() != 0x43584f44 || r.get<uint32_t>() != cacheVersion)
+        return false;
+
+    FileModel model;
+    model.path = r.getString();
+    model.partial = r.get<uint8_t>() != 0;
+    auto count = r.get<uint32_t>();
+    for (uint32_t i = 0; r.ok && i < count; i++) {
+        Include include;
+        include.path = r.getString();
+        include.system = r.get<uint8_t>() != 0;
+        model.includes.push_back(std::move(include));
+    }
+
+    count = r.get<uint32_t>();
+    for (uint32_t i = 0; r.ok && i < count; i++) {
+        auto path = r.getString();
+        auto h = r.get<uint64_t>();
+        // 0 for a file that could not be read then, which still can not be
+        uint64_t current = 0;
+        if (!r.ok || (!hashOf(path, current) && h != 0) || current != h)
+            return false;
+        model.dependencies.push_back(std::move(path));
+    }
+
+    count = r.get<uint32_t>();
+    for (uint32_t i = 0; r.ok && i < count; i++) {
+        Class c;
+        c.name = r.getString();
+        c.ns = r.getString();
+        c.doc = r.getString();
+        auto methods = r.get<uint32_t>();
+        for (uint32_t j = 0; r.ok && j < methods; j++) {
+            Method method;
+            method.name = r.getString();
+            method.doc = r.getString();
+            auto params = r.get<uint32_t>();
+            for (uint32_t k = 0; r.ok && k < params; k++)
+                method.params.push_back(r.getVar());
+            c.methods.push_back(std::move(method));
+        }
+        auto fields = r.get<uint32_t>();
+        for (uint32_t j = 0; r.ok && j < fields; j++)
+            c.fields.push_back(r.getVar());
+        model.classes.push_back(std::move(c));
+    }
+    if (!r.ok)
+        return false;
+    target = std::move(model);
+    return true;
+}
+
+void ModelCache::store(uint64_t key, FileModel const& model) const
+{
+    Writer w;
+    w.put<uint32_t>(0x43584f44); // "DOXC"
+    w.put<uint32_t>(cacheVersion);
+    w.put(model.path);
+    w.put<uint8_t>(model.partial ? 1 : 0);
+
+    w.put(static_cast<uint32_t>(model.includes.size()));
+    for (auto const& include : model.includes) {
+        w.put(include.path);
+        w.put<uint8_t>(include.system ? 1 : 0);
+    }
+
+    // A header can be included more than once
+    std::set<std::string> dependencies(model.dependencies.begin(),
+                                       model.dependencies.end());
+    dependencies.erase("");
+    w.put(static_cast<uint32_t>(dependencies.size()));
+    for (auto const& path : dependencies) {
+        uint64_t h = 0;
+        if (!hashOf(path, h))
+            h = 0;
+        w.put(path);
+        w.put(h);
+    }
+
+    w.put(static_cast<uint32_t>(model.classes.size()));
+    for (auto const& c : model.classes) {
+        w.put(c.name);
+        w.put(c.ns);
+        w.put(c.doc);
+        w.put(static_cast<uint32_t>(c.methods.size()));
+        for (auto const& method : c.methods) {
+            w.put(method.name);
+            w.put(method.doc);
+            w.put(static_cast<uint32_t>(method.params.size()));
+            for (auto const& p : method.params)
+                w.put(p);
+        }
+        w.put(static_cast<uint32_t>(c.fields.size()));
+        for (auto const& f : c.fields)
+            w.put(f);
+    }
+
+    // Write to a temporary and rename, so concurrent runs never see a
+    // partial entry
+    static std::atomic<unsigned> counter{0};
+    auto name = entryName(key);
+    auto tmp = fmt::format("{}.{}.{}", name, getpid(), counter++);
+    {
+        utils::File f{tmp, utils::File::Write};
+        f.writeString(w.data());
+    }
+    if (std::rename(tmp.c_str(), name.c_str()) != 0)
+        std::remove(tmp.c_str());
+}
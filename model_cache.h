@@ -0,0 +1,57 @@
+#pragma once
+
+#include "model.h"
+
+#include <cppast/libclang_parser.hpp>
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Content addressed on-disk cache of distilled file models.
+//
+// An entry is keyed on the contents of a file and the configuration used to
+// parse it. It also records the hashes of every header the file includes,
+// directly or not, and is only used if none of them have changed since.
+// Entries are written in a compact binary format and read back through a
+// memory mapping.
+class ModelCache
+{
+public:
+    explicit ModelCache(std::string const& dir);
+
+    // Returns false if `path` can not be read; it is then left to the parser
+    // to report, and not cached
+    bool key(std::string const& path,
+             cppast::libclang_compile_config const& config,
+             uint64_t& result) const;
+
+    // Models parsed while only the entities `names` refer to are converted
+    // are kept apart from those of other names, and of full parses. Empty
+    // for full parses. Must not be called while files are parsed.
+    void setFilter(std::vector<std::string> names);
+
+    bool load(uint64_t key, FileModel& target) const;
+    void store(uint64_t key, FileModel const& model) const;
+
+private:
+    std::string entryName(uint64_t key) const;
+    // Hash of a file, remembered for as long as it has the same size and
+    // modification time. Headers are shared by many entries.
+    bool hashOf(std::string const& path, uint64_t& result) const;
+
+    struct FileHash
+    {
+        int64_t mtime;
+        int64_t size;
+        uint64_t hash;
+    };
+
+    std::string dir_;
+    // Hash of the filter names, 0 for none
+    uint64_t filter_ = 0;
+    mutable std::mutex mutex_;
+    mutable std::unordered_map<std::string, FileHash> hashes_;
+};
@@ -0,0 +1,188 @@
+#include "parallel_parser.h"
+#include "comment_scanner.h"
+#include "distill.h"
+#include "memory_budget.h"
+#include "model_cache.h"
+#include "trace.h"
+
+#include <algorithm>
+
+namespace {
+unsigned threadCount(unsigned threads)
+{
+    if (threads == 0)
+        threads = std::thread::hardware_concurrency();
+    return std::max(1u, threads);
+}
+} // namespace
+
+ParallelParser::ParallelParser(
+    cppast::libclang_compilation_database const& database,
+    cppast::cpp_entity_index const& index,
+    cppast::diagnostic_logger const& logger, ModelCache const* cache,
+    unsigned threads, std::function<void(Config&)> configure,
+    bool scanComments, MemoryBudget* budget)
+    : database_(database), index_(index), logger_(logger), cache_(cache),
+      configure_(std::move(configure)), scanComments_(scanComments),
+      budget_(budget),
+      queue_(threadCount(threads) * 4)
+{
+    threads = threadCount(threads);
+    for (unsigned i = 0; i < threads; i++)
+        workers_.emplace_back([this] { worker(); });
+}
+
+ParallelParser::~ParallelParser()
+{
+    queue_.close();
+    for (auto& t : workers_)
+        t.join();
+}
+
+bool ParallelParser::markSeen(std::string const& path)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return seen_.insert(path).second;
+}
+
+void ParallelParser::parse(std::string const& path)
+{
+    if (!markSeen(path))
+        return;
+    pending_++;
+    queue_.push(Job{path, nullptr});
+}
+
+void ParallelParser::wait()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this] { return pending_ == 0; });
+}
+
+std::vector<std::unique_ptr<cppast::cpp_file>> ParallelParser::takeFiles()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return std::move(files_);
+}
+
+std::vector<FileModel> ParallelParser::takeModels()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return std::move(models_);
+}
+
+void ParallelParser::finished()
+{
+    if (--pending_ == 0) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        done_.notify_all();
+    }
+}
+
+void ParallelParser::worker()
+{
+    cppast::libclang_parser parser(type_safe::ref(logger_));
+    std::unique_ptr<CommentScanner> scanner;
+    if (scanComments_)
+        scanner = std::make_unique<CommentScanner>();
+    Job job;
+    while (queue_.pop(job))
+        run(parser, scanner.get(), job);
+}
+
+void ParallelParser::follow(cppast::libclang_parser& parser,
+                            CommentScanner* scanner, FileModel const& model,
+                            std::shared_ptr<const Config> const& config)
+{
+    for (auto const& include : model.includes) {
+        if (include.system || include.path.empty() || !markSeen(include.path))
+            continue;
+        Job header{include.path, config};
+        pending_++;
+        // Never block on our own queue; if it is full we parse the header
+        // ourselves instead
+        if (!queue_.tryPush(header))
+            run(parser, scanner, header);
+    }
+}
+
+void ParallelParser::run(cppast::libclang_parser& parser,
+                         CommentScanner* scanner, Job const& job)
+{
+    trace::Scope scope("file", job.path);
+    try {
+        auto config = job.config;
+        if (!config) {
+            auto c = std::make_shared<Config>(database_, job.path);
+            if (configure_)
+                configure_(*c);
+            config = c;
+        }
+        FileModel model;
+        uint64_t key = 0;
+        bool cacheable = cache_ && cache_->key(job.path, *config, key);
+        bool haveModel = false;
+        if (cacheable) {
+            trace::Scope cacheScope("cache", job.path);
+            haveModel = cache_->load(key, model);
+        }
+        if (!haveModel && scanner) {
+            trace::Scope scanScope("scan", job.path);
+            if (auto scanned = scanner->scan(job.path)) {
+                model = std::move(*scanned);
+                haveModel = true;
+            } else {
+                logger_.log("dox", cppast::diagnostic{
+                                       "parsing instead of scanning: " +
+                                           scanner->reason(),
+                                       cppast::source_location::make_file(job.path),
+                                       cppast::severity::debug});
+            }
+        }
+        if (!haveModel) {
+            // Declared first so it is released last, after the AST and the
+            // index that points into it are gone
+            std::unique_ptr<MemoryBudget::Scope> room;
+            std::unique_ptr<cppast::cpp_entity_index> index;
+            if (budget_) {
+                room = std::make_unique<MemoryBudget::Scope>(*budget_);
+                index = std::make_unique<cppast::cpp_entity_index>();
+            }
+            auto file = parser.parse(index ? *index : index_, job.path, *config);
+            bool failed = parser.error();
+            if (failed) {
+                error_ = true;
+                parser.reset_error();
+            }
+            if (file) {
+                {
+                    trace::Scope distillScope("distill", job.path);
+                    model = distill(*file);
+                }
+                model.partial = static_cast<bool>(
+                    cppast::detail::libclang_compile_config_access::
+                        entity_filter(*config));
+                // Keep failures out of the cache so they are reported again
+                if (cacheable && !failed) {
+                    trace::Scope storeScope("store", job.path);
+                    cache_->store(key, model);
+                }
+                if (!budget_) {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    files_.push_back(std::move(file));
+                }
+            }
+        }
+        follow(parser, scanner, model, config);
+        if (!model.path.empty()) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            models_.push_back(std::move(model));
+        }
+    } catch (std::exception const& e) {
+        logger_.log("dox", cppast::diagnostic{
+                               e.what(), cppast::source_location::make_file(job.path),
+                               cppast::severity::error});
+        error_ = true;
+    }
+    finished();
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "bounded_queue.h"
+#include "model.h"
+
+#include <cppast/libclang_parser.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+class CommentScanner;
+class MemoryBudget;
+class ModelCache;
+
+// Parses translation units from a compilation database on a pool of worker
+// threads. Every worker owns its own `libclang_parser`, and all results are
+// registered in one shared index.
+// Local headers included by the parsed files are parsed once, using the
+// configuration of the first translation unit that included them.
+// If a cache is given, files whose entry is still valid are not parsed at all.
+// With `scanComments`, files are read with a `CommentScanner` first, and only
+// parsed if it gives up on them.
+// With a `budget`, every file is parsed into an index of its own, and only
+// its model is kept; parsing waits while the budget is exceeded.
+class ParallelParser
+{
+public:
+    using Config = cppast::libclang_compile_config;
+
+    // `configure` is applied to every config taken from the database
+    ParallelParser(cppast::libclang_compilation_database const& database,
+                   cppast::cpp_entity_index const& index,
+                   cppast::diagnostic_logger const& logger,
+                   ModelCache const* cache = nullptr, unsigned threads = 0,
+                   std::function<void(Config&)> configure = {},
+                   bool scanComments = false,
+                   MemoryBudget* budget = nullptr);
+    ~ParallelParser();
+
+    // Queue a source file for parsing. Blocks while the queue is full.
+    void parse(std::string const& path);
+
+    // Wait until all queued files, and the headers they include, are parsed
+    void wait();
+
+    // Move out the files parsed so far. Files that came from the cache, or
+    // were scanned or streamed, only have a model.
+    std::vector<std::unique_ptr<cppast::cpp_file>> takeFiles();
+    std::vector<FileModel> takeModels();
+
+    bool error() const { return error_; }
+
+private:
+    struct Job
+    {
+        std::string path;
+        // Null for source files; the worker then looks it up in the database
+        std::shared_ptr<const Config> config;
+    };
+
+    void worker();
+    void run(cppast::libclang_parser& parser, CommentScanner* scanner,
+             Job const& job);
+    void follow(cppast::libclang_parser& parser, CommentScanner* scanner,
+                FileModel const& model,
+                std::shared_ptr<const Config> const& config);
+    bool markSeen(std::string const& path);
+    void finished();
+
+    cppast::libclang_compilation_database const& database_;
+    cppast::cpp_entity_index const& index_;
+    cppast::diagnostic_logger const& logger_;
+    ModelCache const* cache_;
+    std::function<void(Config&)> configure_;
+    bool scanComments_;
+    MemoryBudget* budget_;
+
+    BoundedQueue<Job> queue_;
+    std::vector<std::thread> workers_;
+
+    std::atomic<int> pending_{0};
+    std::atomic<bool> error_{false};
+
+    std::mutex mutex_;
+    std::condition_variable done_;
+    std::unordered_set<std::string> seen_;
+    std::vector<std::unique_ptr<cppast::cpp_file>> files_;
+    std::vector<FileModel> models_;
+};
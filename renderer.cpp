@@ -0,0 +1,258 @@
+#include "renderer.h"
+#include "cpp_parser.h"
+#include "lua_template.h"
+#include "template_tokenizer.h"
+#include "trace.h"
+
+#include <coreutils/output_buffer.h>
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace {
+
+int appendChunk(lua_State*, const void* data, size_t size, void* target)
+{
+    static_cast<std::string*>(target)->append(static_cast<const char*>(data),
+                                              size);
+    return 0;
+}
+
+std::string dump(sol::protected_function const& f)
+{
+    std::string bytecode;
+    auto* L = f.lua_state();
+    f.push();
+    lua_dump(L, appendChunk, &bytecode, 0);
+    lua_pop(L, 1);
+    return bytecode;
+}
+
+} // namespace
+
+Renderer::Renderer()
+{
+    lua_.open_libraries(sol::lib::base, sol::lib::string, sol::lib::table,
+                        sol::lib::math);
+    bind();
+}
+
+Renderer::Context& Renderer::context()
+{
+    if (!context_)
+        throw std::runtime_error("Not rendering");
+    return *context_;
+}
+
+void Renderer::fail(std::string const& message)
+{
+    // A C++ exception would be caught by Lua and lose its message, so raise
+    // a Lua error instead. Lua is built as C++, so this still unwinds.
+    luaL_error(lua_.lua_state(), "%s", message.c_str());
+    std::abort(); // Not reached
+}
+
+void Renderer::bind()
+{
+    lua_.set_function("__emit", [this](size_t offset, size_t size) {
+        auto& ctx = context();
+        if (offset > ctx.doc.size() || size > ctx.doc.size() - offset)
+            fail("Template changed while rendering");
+        ctx.out->write(ctx.doc.substr(offset, size));
+    });
+    emit_ = lua_["__emit"];
+    lua_["__emit"] = sol::nil;
+
+    lua_["print"] = [this](std::string_view text) {
+        context().out->write(text);
+    };
+    lua_["source"] = [this](std::string const& file) {
+        auto& ctx = context();
+        try {
+            ctx.parser->load(file);
+        } catch (std::exception const& e) {
+            fail(e.what());
+        }
+        ctx.used.insert(resolvePath(file.c_str()));
+    };
+
+    auto symbol = [this](std::string const& name) {
+        auto& ctx = context();
+        std::string file;
+        auto* c = ctx.parser->resolveClass(name, &file);
+        if (!c)
+            fail("Unknown symbol '" + name + "'");
+        ctx.used.insert(file);
+        ctx.symbol = c->ns.empty() ? c->name : c->ns + "::" + c->name;
+        ctx.method.clear();
+        ctx.overload = 0;
+    };
+    lua_["symbol"] = symbol;
+    lua_["class"] = symbol;
+    lua_["enddoc"] = [this] {
+        context().symbol.clear();
+        context().method.clear();
+    };
+
+    auto currentClass = [this]() -> Class const& {
+        auto& ctx = context();
+        auto* c = ctx.symbol.empty() ? nullptr
+                                     : ctx.parser->findClass(ctx.symbol);
+        if (!c)
+            fail("No current symbol");
+        return *c;
+    };
+    auto currentMethod = [this]() -> Method const& {
+        auto& ctx = context();
+        auto overloads = ctx.parser->symbols().find(ctx.method);
+        if (ctx.method.empty() || ctx.overload >= overloads.size())
+            fail("No current method");
+        return overloads.first[ctx.overload].method();
+    };
+
+    // Pick overload `n` (from 1) of a method of the current class. Returns
+    // the number of overloads.
+    lua_["method"] = [this, currentClass](std::string const& name,
+                                          sol::optional<size_t> n) {
+        using Kind = SymbolIndex::Kind;
+        currentClass();
+        auto& ctx = context();
+        auto qualified = ctx.symbol + "::" + name;
+        auto overloads = ctx.parser->symbols().find(qualified);
+        size_t index = n ? *n - 1 : 0;
+        if (overloads.empty() || overloads.first->kind != Kind::Method ||
+            index >= overloads.size())
+            fail("Unknown method '" + name + "'");
+        ctx.method = qualified;
+        ctx.overload = index;
+        return overloads.size();
+    };
+    // By name, or by number starting at 1
+    lua_["param"] = [this, currentMethod](sol::object which) {
+        auto const& params = currentMethod().params;
+        auto it = params.end();
+        if (which.is<size_t>()) {
+            auto n = which.as<size_t>();
+            if (n >= 1 && n <= params.size())
+                it = params.begin() + static_cast<ptrdiff_t>(n - 1);
+        } else if (which.is<std::string>()) {
+            auto name = which.as<std::string>();
+            it = std::find_if(params.begin(), params.end(),
+                              [&](Var const& v) { return v.name == name; });
+        }
+        if (it == params.end())
+            fail("Unknown parameter");
+        return lua_.create_table_with("name", it->name, "type", it->type,
+                                      "doc", it->doc);
+    };
+    // Of a symbol, looked up from the current class outwards. Without a
+    // name, of the current method or class.
+    lua_["doc_comment"] = [this, currentClass, currentMethod](
+                              sol::optional<std::string> name) -> std::string {
+        using Kind = SymbolIndex::Kind;
+        auto& ctx = context();
+        if (!name)
+            return ctx.method.empty() ? currentClass().doc
+                                      : currentMethod().doc;
+        auto found = ctx.parser->symbols().find(*name, ctx.symbol);
+        if (found.empty()) {
+            if (auto* c = ctx.parser->resolveClass(*name))
+                return c->doc;
+            fail("Unknown symbol '" + *name + "'");
+        }
+        auto const& s = *found.first;
+        switch (s.kind) {
+        case Kind::Method:
+            return s.method().doc;
+        case Kind::Field:
+            return s.field().doc;
+        default:
+            return s.owner->doc;
+        }
+    };
+}
+
+sol::protected_function Renderer::load(std::string const& name,
+                                       std::string_view doc,
+                                       TemplateCache const* cache)
+{
+    auto key = TemplateCache::key(name, doc);
+    if (chunk_.valid() && key == chunkKey_)
+        return chunk_;
+
+    trace::Scope scope("compile", name);
+    auto chunkName = "@" + name;
+    std::string bytecode;
+    if (cache && cache->load(key, bytecode)) {
+        auto loaded = lua_.load_buffer(bytecode.data(), bytecode.size(),
+                                       chunkName, sol::load_mode::binary);
+        // Otherwise it was written by another version of Lua; compile again
+        if (loaded.valid()) {
+            chunk_ = loaded;
+            chunkKey_ = key;
+            return chunk_;
+        }
+    }
+
+    auto loaded =
+        lua_.load(compileTemplate(doc), chunkName, sol::load_mode::text);
+    if (!loaded.valid()) {
+        sol::error err = loaded;
+        throw template_error(err.what());
+    }
+    chunk_ = loaded;
+    chunkKey_ = key;
+    if (cache)
+        cache->store(key, dump(chunk_));
+    return chunk_;
+}
+
+std::unordered_set<std::string> Renderer::render(CppParser& parser,
+                                                 std::string const& name,
+                                                 std::string_view doc,
+                                                 utils::OutputBuffer& out,
+                                                 TemplateCache const* cache)
+{
+    auto chunk = load(name, doc, cache);
+
+    sol::environment env(lua_, sol::create, lua_.globals());
+    env.set_on(chunk);
+
+    Context ctx;
+    ctx.parser = &parser;
+    ctx.doc = doc;
+    ctx.out = &out;
+    context_ = &ctx;
+    trace::Scope scope("run", name);
+    auto result = chunk(emit_);
+    context_ = nullptr;
+    if (!result.valid()) {
+        sol::error err = result;
+        throw template_error(err.what());
+    }
+    return std::move(ctx.used);
+}
+
+RendererPool::RendererPool(size_t size)
+{
+    for (size_t i = 0; i < size; i++)
+        free_.push_back(std::make_unique<Renderer>());
+}
+
+RendererPool::Handle RendererPool::acquire()
+{
+    std::unique_ptr<Renderer> renderer;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!free_.empty()) {
+            renderer = std::move(free_.back());
+            free_.pop_back();
+        }
+    }
+    if (!renderer)
+        renderer = std::make_unique<Renderer>();
+    return Handle(renderer.release(), [this](Renderer* r) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        free_.emplace_back(r);
+    });
+}
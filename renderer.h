@@ -0,0 +1,89 @@
+#pragma once
+
+#include <limits> // Used but not included by sol.hpp
+
+#include <sol2/sol.hpp>
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+class CppParser;
+class TemplateCache;
+
+namespace utils {
+class OutputBuffer;
+}
+
+// A Lua state with the dox functions registered, that renders compiled
+// templates. The compiled chunk of the last template is kept, and every
+// render runs in a fresh environment so globals set by one document do not
+// leak into the next.
+class Renderer
+{
+public:
+    Renderer();
+    Renderer(Renderer const&) = delete;
+    Renderer& operator=(Renderer const&) = delete;
+
+    // Render the template `doc`, read from `name`, into `out`. Compiled
+    // templates are kept in `cache` if it is set. Returns the source files
+    // that were used.
+    std::unordered_set<std::string> render(CppParser& parser,
+                                           std::string const& name,
+                                           std::string_view doc,
+                                           utils::OutputBuffer& out,
+                                           TemplateCache const* cache);
+
+private:
+    // What the bindings work on during a render
+    struct Context
+    {
+        CppParser* parser = nullptr;
+        std::string_view doc;
+        utils::OutputBuffer* out = nullptr;
+        std::unordered_set<std::string> used;
+        // Qualified names of the current class and method, and which
+        // overload of the method
+        std::string symbol;
+        std::string method;
+        size_t overload = 0;
+    };
+
+    void bind();
+    [[noreturn]] void fail(std::string const& message);
+    sol::protected_function load(std::string const& name,
+                                 std::string_view doc,
+                                 TemplateCache const* cache);
+    Context& context();
+
+    sol::state lua_;
+    sol::function emit_;
+    Context* context_ = nullptr;
+
+    uint64_t chunkKey_ = 0;
+    sol::protected_function chunk_;
+};
+
+// Renderers that are ready to use, so the cost of setting up Lua is only
+// paid once per thread rather than once per document
+class RendererPool
+{
+public:
+    using Handle = std::unique_ptr<Renderer, std::function<void(Renderer*)>>;
+
+    // Create `size` renderers up front
+    explicit RendererPool(size_t size = 1);
+
+    // Take a renderer, creating one if none is free. It goes back to the
+    // pool when the handle is destroyed.
+    Handle acquire();
+
+private:
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<Renderer>> free_;
+};
@@ -0,0 +1,54 @@
+#include "string_pool.h"
+
+#include <cstring>
+
+char* StringPool::allocate(size_t size)
+{
+    if (size > left_) {
+        // Big strings get a block of their own, so the current one is kept
+        if (size > blockSize / 4) {
+            blocks_.emplace_back(new char[size]);
+            bytes_ += size;
+            return blocks_.back().get();
+        }
+        blocks_.emplace_back(new char[blockSize]);
+        bytes_ += blockSize;
+        next_ = blocks_.back().get();
+        left_ = blockSize;
+    }
+    auto* p = next_;
+    next_ += size;
+    left_ -= size;
+    return p;
+}
+
+std::string_view StringPool::intern(std::string_view s)
+{
+    auto it = strings_.find(s);
+    if (it != strings_.end())
+        return *it;
+    auto* p = allocate(s.size());
+    std::memcpy(p, s.data(), s.size());
+    std::string_view stored(p, s.size());
+    strings_.insert(stored);
+    return stored;
+}
+
+std::string_view StringPool::intern(std::string_view a, std::string_view b)
+{
+    if (a.empty())
+        return intern(b);
+    scratch_.assign(a.data(), a.size());
+    scratch_ += "::";
+    scratch_.append(b.data(), b.size());
+    return intern(scratch_);
+}
+
+void StringPool::clear()
+{
+    blocks_.clear();
+    next_ = nullptr;
+    left_ = 0;
+    bytes_ = 0;
+    strings_.clear();
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+// Interned strings, allocated from large blocks. Every distinct string is
+// stored once, and the views returned stay valid as long as the pool.
+class StringPool
+{
+public:
+    StringPool() = default;
+    StringPool(StringPool const&) = delete;
+    StringPool& operator=(StringPool const&) = delete;
+
+    std::string_view intern(std::string_view s);
+
+    // Intern the qualified name `a`::`b`, or just `b` if `a` is empty
+    std::string_view intern(std::string_view a, std::string_view b);
+
+    // Drop the lookup table, keeping the strings. Only saves memory; later
+    // `intern()` calls may store duplicates.
+    void freeze() { strings_ = {}; }
+
+    // Make room for `count` distinct strings in the lookup table
+    void reserve(size_t count) { strings_.reserve(count); }
+
+    // Forget every string; views handed out before are no longer valid
+    void clear();
+
+    size_t bytes() const { return bytes_; }
+
+private:
+    char* allocate(size_t size);
+
+    static constexpr size_t blockSize = 64 * 1024;
+    std::vector<std::unique_ptr<char[]>> blocks_;
+    char* next_ = nullptr;
+    size_t left_ = 0;
+    size_t bytes_ = 0;
+    std::unordered_set<std::string_view> strings_;
+    std::string scratch_;
+};
@@ -0,0 +1,202 @@
+#include "symbol_index.h"
+#include "hash.h"
+
+#include <algorithm>
+#include <tuple>
+
+namespace {
+
+uint64_t hashName(std::string_view s, uint64_t h = fnvBasis)
+{
+    return hash(s.data(), s.size(), h);
+}
+
+// Hash of `scope`::`name`, without building it
+uint64_t hashScoped(std::string_view scope, std::string_view name)
+{
+    if (scope.empty())
+        return hashName(name);
+    return hashName(name, hashName("::", hashName(scope)));
+}
+
+bool isScoped(std::string_view qualified, std::string_view scope,
+              std::string_view name)
+{
+    if (scope.empty())
+        return qualified == name;
+    return qualified.size() == scope.size() + 2 + name.size() &&
+           qualified.compare(0, scope.size(), scope) == 0 &&
+           qualified.compare(scope.size(), 2, "::") == 0 &&
+           qualified.compare(scope.size() + 2, name.size(), name) == 0;
+}
+
+} // namespace
+
+void SymbolIndex::build(
+    std::unordered_map<std::string, FileModel> const& models)
+{
+    strings_.clear();
+    symbols_.clear();
+
+    auto add = [&](std::string_view name, std::string_view file,
+                   Class const* owner, size_t member, size_t shortLength,
+                   Kind kind) {
+        symbols_.push_back({name, file, owner, static_cast<uint32_t>(member),
+                            static_cast<uint32_t>(name.size() - shortLength),
+                            kind});
+    };
+    size_t count = 0;
+    for (auto const& entry : models)
+        for (auto const& c : entry.second.classes)
+            count += 1 + c.methods.size() + c.fields.size();
+    symbols_.reserve(count);
+    strings_.reserve(count + models.size());
+
+    for (auto const& entry : models) {
+        auto file = strings_.intern(entry.first);
+        for (auto const& c : entry.second.classes) {
+            auto name = strings_.intern(c.ns, c.name);
+            add(name, file, &c, 0, c.name.size(), Kind::Class);
+            for (size_t i = 0; i < c.methods.size(); i++)
+                add(strings_.intern(name, c.methods[i].name), file, &c, i,
+                    c.methods[i].name.size(), Kind::Method);
+            for (size_t i = 0; i < c.fields.size(); i++)
+                add(strings_.intern(name, c.fields[i].name), file, &c, i,
+                    c.fields[i].name.size(), Kind::Field);
+        }
+    }
+    // Nothing more is interned until the next build
+    strings_.freeze();
+
+    // Same order on every run, whatever order the models came in
+    std::sort(symbols_.begin(), symbols_.end(),
+              [](Symbol const& a, Symbol const& b) {
+                  return std::tie(a.name, a.kind, a.file, a.member) <
+                         std::tie(b.name, b.kind, b.file, b.member);
+              });
+    table_ = makeTable(symbols_.size(),
+                       [&](size_t i) { return symbols_[i].name; });
+
+    byName_.clear();
+    byName_.reserve(symbols_.size());
+    for (auto const& s : symbols_)
+        byName_.push_back(&s);
+    // Stable, so symbols with the same name stay sorted on qualified name
+    std::stable_sort(byName_.begin(), byName_.end(),
+                     [](Symbol const* a, Symbol const* b) {
+                         return a->unqualified() < b->unqualified();
+                     });
+    nameTable_ = makeTable(byName_.size(),
+                           [&](size_t i) { return byName_[i]->unqualified(); });
+}
+
+// Make a table with a slot for every run of equal keys in a sorted sequence
+template <typename Key>
+std::vector<SymbolIndex::Slot> SymbolIndex::makeTable(size_t size, Key key)
+{
+    size_t runs = 0;
+    for (size_t i = 0; i < size; i++)
+        if (i == 0 || key(i) != key(i - 1))
+            runs++;
+    // At most 3/4 full, so probe sequences stay short
+    size_t capacity = 16;
+    while (capacity * 3 < runs * 4)
+        capacity *= 2;
+
+    std::vector<Slot> table(capacity, Slot{0, emptySlot, 0});
+    auto mask = capacity - 1;
+    for (size_t i = 0; i < size;) {
+        auto j = i + 1;
+        while (j < size && key(j) == key(i))
+            j++;
+        auto h = static_cast<uint32_t>(hashName(key(i)));
+        auto pos = h & mask;
+        while (table[pos].first != emptySlot)
+            pos = (pos + 1) & mask;
+        table[pos] = {h, static_cast<uint32_t>(i), static_cast<uint32_t>(j - i)};
+        i = j;
+    }
+    return table;
+}
+
+template <typename Matches>
+SymbolIndex::Slot const* SymbolIndex::lookup(std::vector<Slot> const& table,
+                                             uint64_t hash,
+                                             Matches matches) const
+{
+    if (table.empty())
+        return nullptr;
+    auto mask = table.size() - 1;
+    auto h = static_cast<uint32_t>(hash);
+    for (auto pos = h & mask; table[pos].first != emptySlot;
+         pos = (pos + 1) & mask) {
+        if (table[pos].hash == h && matches(table[pos]))
+            return &table[pos];
+    }
+    return nullptr;
+}
+
+SymbolIndex::Symbols SymbolIndex::find(uint64_t hash, std::string_view scope,
+                                       std::string_view name) const
+{
+    auto* slot = lookup(table_, hash, [&](Slot const& s) {
+        return isScoped(symbols_[s.first].name, scope, name);
+    });
+    if (!slot)
+        return {};
+    auto* first = symbols_.data() + slot->first;
+    return {first, first + slot->count};
+}
+
+SymbolIndex::Symbols SymbolIndex::find(std::string_view qualified) const
+{
+    return find(hashName(qualified), {}, qualified);
+}
+
+SymbolIndex::Symbols SymbolIndex::find(std::string_view name,
+                                       std::string_view scope) const
+{
+    // Explicitly global
+    if (name.compare(0, 2, "::") == 0)
+        return find(name.substr(2));
+    while (true) {
+        auto result = find(hashScoped(scope, name), scope, name);
+        if (!result.empty() || scope.empty())
+            return result;
+        auto outer = scope.rfind("::");
+        scope = outer == std::string_view::npos ? std::string_view()
+                                                : scope.substr(0, outer);
+    }
+}
+
+SymbolIndex::Symbols SymbolIndex::withPrefix(std::string_view prefix) const
+{
+    auto first = std::lower_bound(
+        symbols_.begin(), symbols_.end(), prefix,
+        [](Symbol const& s, std::string_view p) { return s.name < p; });
+    auto last = std::partition_point(first, symbols_.end(),
+                                     [&](Symbol const& s) {
+                                         return s.name.compare(0, prefix.size(),
+                                                               prefix) == 0;
+                                     });
+    return {symbols_.data() + (first - symbols_.begin()),
+            symbols_.data() + (last - symbols_.begin())};
+}
+
+SymbolIndex::SymbolRefs SymbolIndex::named(std::string_view name) const
+{
+    auto* slot = lookup(nameTable_, hashName(name), [&](Slot const& s) {
+        return byName_[s.first]->unqualified() == name;
+    });
+    if (!slot)
+        return {};
+    auto* first = byName_.data() + slot->first;
+    return {first, first + slot->count};
+}
+
+size_t SymbolIndex::memory() const
+{
+    return strings_.bytes() + symbols_.capacity() * sizeof(Symbol) +
+           (table_.capacity() + nameTable_.capacity()) * sizeof(Slot) +
+           byName_.capacity() * sizeof(Symbol const*);
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "model.h"
+#include "string_pool.h"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Flat index of every class, method and field in a set of file models.
+//
+// Symbols are kept in one array sorted by qualified name, so overloads are
+// next to each other and prefix queries are a binary search. Exact lookups
+// go through an open addressing table of name hashes that points into the
+// array, which normally costs one cache miss for the table and one for the
+// symbol. Names are interned in a `StringPool`.
+class SymbolIndex
+{
+public:
+    enum class Kind : uint8_t
+    {
+        Class,
+        Method,
+        Field
+    };
+
+    struct Symbol
+    {
+        std::string_view name; // Qualified, e.g. "ns::Foo::bar"
+        std::string_view file;
+        // The class, or the class the member belongs to
+        Class const* owner;
+        // Index into `owner->methods` or `owner->fields`
+        uint32_t member;
+        // Where the unqualified name starts in `name`
+        uint32_t shortName;
+        Kind kind;
+
+        std::string_view unqualified() const { return name.substr(shortName); }
+        Method const& method() const { return owner->methods[member]; }
+        Var const& field() const { return owner->fields[member]; }
+    };
+
+    template <typename It> struct Range
+    {
+        It first{};
+        It last{};
+        It begin() const { return first; }
+        It end() const { return last; }
+        bool empty() const { return first == last; }
+        size_t size() const { return static_cast<size_t>(last - first); }
+    };
+    using Symbols = Range<Symbol const*>;
+    using SymbolRefs = Range<Symbol const* const*>;
+
+    SymbolIndex() = default;
+    SymbolIndex(SymbolIndex const&) = delete;
+    SymbolIndex& operator=(SymbolIndex const&) = delete;
+
+    // Index `models`, which must not change while the index is used
+    void build(std::unordered_map<std::string, FileModel> const& models);
+
+    // Every symbol with this qualified name; more than one for overloads
+    Symbols find(std::string_view qualified) const;
+
+    // Look `name` up from inside `scope` the way C++ does; first in
+    // `scope`, then in each enclosing scope out to the global one
+    Symbols find(std::string_view name, std::string_view scope) const;
+
+    // Every symbol whose qualified name starts with `prefix`, sorted
+    Symbols withPrefix(std::string_view prefix) const;
+
+    // Every symbol with this unqualified name, in any scope
+    SymbolRefs named(std::string_view name) const;
+
+    size_t size() const { return symbols_.size(); }
+
+    // Approximate heap use, in bytes
+    size_t memory() const;
+
+private:
+    // Only the low 32 bits of the hash are kept; a match is confirmed by
+    // comparing the name
+    struct Slot
+    {
+        uint32_t hash;
+        uint32_t first; // Index of the first match, ~0 for an empty slot
+        uint32_t count;
+    };
+    static constexpr uint32_t emptySlot = ~0U;
+
+    template <typename Key>
+    static std::vector<Slot> makeTable(size_t size, Key key);
+    template <typename Matches>
+    Slot const* lookup(std::vector<Slot> const& table, uint64_t hash,
+                       Matches matches) const;
+    Symbols find(uint64_t hash, std::string_view scope,
+                 std::string_view name) const;
+
+    StringPool strings_;
+    std::vector<Symbol> symbols_;
+    std::vector<Slot> table_;
+    // Symbols sorted by unqualified name, and its table
+    std::vector<Symbol const*> byName_;
+    std::vector<Slot> nameTable_;
+};
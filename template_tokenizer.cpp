@@ -0,0 +1,142 @@
+#include "template_tokenizer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+namespace {
+
+// Length of a Lua long bracket opening (`[[`, `[==[` ...) at `pos`, or 0
+size_t longBracket(std::string_view s, size_t pos, size_t& level)
+{
+    if (s[pos] != '[')
+        return 0;
+    size_t i = pos + 1;
+    while (i < s.size() && s[i] == '=')
+        i++;
+    if (i >= s.size() || s[i] != '[')
+        return 0;
+    level = i - pos - 1;
+    return i - pos + 1;
+}
+
+} // namespace
+
+bool TemplateTokenizer::next(Segment& segment)
+{
+    while (pos_ < input_.size()) {
+        auto start = pos_;
+        // Text runs until the next `@{`; memchr is much faster than
+        // looking at every character
+        auto at = start;
+        while (true) {
+            auto* p = static_cast<const char*>(
+                std::memchr(input_.data() + at, '@', input_.size() - at));
+            if (!p) {
+                at = input_.size();
+                break;
+            }
+            at = p - input_.data();
+            if (at + 1 < input_.size() && input_[at + 1] == '{')
+                break;
+            at++;
+        }
+
+        if (at > start) {
+            segment = {Segment::Text, input_.substr(start, at - start)};
+            pos_ = at;
+            return true;
+        }
+
+        // Code
+        auto codeStart = at + 2;
+        auto end = endOfCode(codeStart);
+        if (end == std::string_view::npos) {
+            pos_ = at;
+            throw template_error("Unterminated '@{' on line " +
+                                 std::to_string(line()));
+        }
+        // `@}` closes the code; the '@' is not part of it
+        auto codeEnd =
+            end > codeStart && input_[end - 1] == '@' ? end - 1 : end;
+        pos_ = end + 1;
+        if (codeEnd > codeStart) {
+            segment = {Segment::Code,
+                       input_.substr(codeStart, codeEnd - codeStart)};
+            return true;
+        }
+    }
+    return false;
+}
+
+// Position of the '}' that ends code starting at `start`, or npos
+size_t TemplateTokenizer::endOfCode(size_t start) const
+{
+    int depth = 1;
+    auto size = input_.size();
+    for (size_t i = start; i < size; i++) {
+        char c = input_[i];
+        switch (c) {
+        case '{':
+            depth++;
+            break;
+        case '}':
+            if (--depth == 0 || (i > start && input_[i - 1] == '@'))
+                return i;
+            break;
+        case '"':
+        case '\'':
+            for (i++; i < size && input_[i] != c; i++) {
+                if (input_[i] == '\\')
+                    i++;
+                else if (input_[i] == '\n')
+                    break; // Unfinished string; let Lua complain about it
+            }
+            if (i >= size)
+                return std::string_view::npos;
+            break;
+        case '[':
+            i = endOfLongBracket(i);
+            break;
+        case '-':
+            if (i + 1 < size && input_[i + 1] == '-') {
+                i += 2;
+                size_t level;
+                if (i < size && longBracket(input_, i, level) > 0)
+                    i = endOfLongBracket(i);
+                else {
+                    while (i < size && input_[i] != '\n')
+                        i++;
+                }
+            }
+            break;
+        default:
+            break;
+        }
+        if (i >= size)
+            return std::string_view::npos;
+    }
+    return std::string_view::npos;
+}
+
+// If a long bracket starts at `pos`, return the position of its last
+// character; otherwise return `pos`
+size_t TemplateTokenizer::endOfLongBracket(size_t pos) const
+{
+    size_t level = 0;
+    auto len = longBracket(input_, pos, level);
+    if (len == 0)
+        return pos;
+    std::string close = "]" + std::string(level, '=') + "]";
+    auto end = input_.find(close, pos + len);
+    if (end == std::string_view::npos)
+        return input_.size();
+    return end + close.size() - 1;
+}
+
+size_t TemplateTokenizer::line() const
+{
+    return static_cast<size_t>(std::count(input_.begin(),
+                                          input_.begin() + pos_, '\n')) +
+           1;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <stdexcept>
+#include <string_view>
+
+// A piece of a template; either text to copy to the output, or the Lua code
+// between `@{` and `}`
+struct Segment
+{
+    enum Kind
+    {
+        Text,
+        Code
+    };
+    Kind kind = Text;
+    std::string_view text;
+};
+
+class template_error : public std::runtime_error
+{
+public:
+    using std::runtime_error::runtime_error;
+};
+
+// Splits a template into segments without copying it; the segments point
+// into `input`, which must outlive them.
+// Braces inside Lua strings and comments do not count, and `@}` always
+// ends the code, however many braces are open.
+class TemplateTokenizer
+{
+public:
+    explicit TemplateTokenizer(std::string_view input) : input_(input) {}
+
+    // Get the next non-empty segment. Returns false at the end of the input.
+    // Throws `template_error` if a code segment is not closed.
+    bool next(Segment& segment);
+
+    // Line number (1-based) of the current position, for error messages
+    size_t line() const;
+
+private:
+    size_t endOfCode(size_t start) const;
+    size_t endOfLongBracket(size_t pos) const;
+
+    std::string_view input_;
+    size_t pos_ = 0;
+};
@@ -0,0 +1,217 @@
+#include <catch2/catch.hpp>
+
+#include "../comment_scanner.h"
+
+#include <cctype>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+
+// Split `source` into tokens the way libclang does, for the little C++ the
+// tests use
+std::vector<ScanToken> tokenize(std::string const& source)
+{
+    static const std::unordered_set<std::string> keywords = {
+        "class",  "struct",   "enum",     "namespace", "template",
+        "const",  "volatile", "static",   "virtual",   "public",
+        "private", "void",    "bool",     "char",      "short",
+        "int",    "long",     "unsigned", "signed",    "double",
+        "float",  "auto",     "decltype", "typename",  "operator"};
+    static const char* const operators[] = {"::", "->", "&&", "||", "<<",
+                                            ">>", "<=", ">=", "==", "!=",
+                                            "..."};
+
+    std::vector<ScanToken> tokens;
+    unsigned line = 1;
+    unsigned column = 1;
+    size_t i = 0;
+    auto advance = [&](size_t n) {
+        for (; n > 0; n--, i++) {
+            if (source[i] == '\n') {
+                line++;
+                column = 1;
+            } else
+                column++;
+        }
+    };
+    while (i < source.size()) {
+        auto c = source[i];
+        if (std::isspace(static_cast<unsigned char>(c))) {
+            advance(1);
+            continue;
+        }
+        ScanToken token{ScanToken::Punctuation, "", line, column};
+        auto start = i;
+        if (source.compare(i, 2, "//") == 0) {
+            advance(source.find('\n', i) - i);
+            token.kind = ScanToken::Comment;
+        } else if (source.compare(i, 2, "/*") == 0) {
+            advance(source.find("*/", i) + 2 - i);
+            token.kind = ScanToken::Comment;
+        } else if (std::isalpha(static_cast<unsigned char>(c)) || c == '_') {
+            while (i < source.size() &&
+                   (std::isalnum(static_cast<unsigned char>(source[i])) ||
+                    source[i] == '_'))
+                advance(1);
+            token.kind = keywords.count(source.substr(start, i - start))
+                             ? ScanToken::Keyword
+                             : ScanToken::Identifier;
+        } else if (std::isdigit(static_cast<unsigned char>(c))) {
+            while (i < source.size() &&
+                   std::isalnum(static_cast<unsigned char>(source[i])))
+                advance(1);
+            token.kind = ScanToken::Literal;
+        } else if (c == '"') {
+            advance(source.find('"', i + 1) + 1 - i);
+            token.kind = ScanToken::Literal;
+        } else {
+            size_t length = 1;
+            for (auto op : operators)
+                if (source.compare(i, std::strlen(op), op) == 0)
+                    length = std::strlen(op);
+            advance(length);
+        }
+        token.spelling = source.substr(start, i - start);
+        tokens.push_back(std::move(token));
+    }
+    return tokens;
+}
+
+std::optional<FileModel> scan(std::string const& source,
+                              std::string* reason = nullptr)
+{
+    return scanTokens("test.h", source, tokenize(source), reason);
+}
+
+// The reason the scanner gives up on `source`
+std::string unsure(std::string const& source)
+{
+    std::string reason;
+    auto model = scan(source, &reason);
+    REQUIRE(!model);
+    return reason;
+}
+
+} // namespace
+
+TEST_CASE("Classes, members and doc comments", "[comment_scanner]")
+{
+    auto model = scan(R"(#ifndef TEST_H
+#define TEST_H
+
+namespace ns {
+
+/// A class
+class Foo
+{
+public:
+    /// Does bar
+    int bar(int x, double y) const;
+
+    /// The size
+    unsigned size;
+
+private:
+    void hidden();
+};
+
+} // namespace ns
+
+#endif
+)");
+    REQUIRE(model);
+    REQUIRE(model->path == "test.h");
+    REQUIRE(model->classes.size() == 1);
+
+    auto const& c = model->classes[0];
+    REQUIRE(c.ns == "ns");
+    REQUIRE(c.name == "Foo");
+    REQUIRE(c.doc == "A class");
+    REQUIRE(c.methods.size() == 2);
+    REQUIRE(c.methods[0].name == "bar");
+    REQUIRE(c.methods[0].doc == "Does bar");
+    REQUIRE(c.methods[0].params.size() == 2);
+    REQUIRE(c.methods[0].params[0].name == "x");
+    REQUIRE(c.methods[0].params[1].type == "double");
+    REQUIRE(c.methods[1].name == "hidden");
+    REQUIRE(c.fields.size() == 1);
+    REQUIRE(c.fields[0].name == "size");
+    REQUIRE(c.fields[0].type == "unsigned int");
+    REQUIRE(c.fields[0].doc == "The size");
+}
+
+TEST_CASE("Types are spelled like cppast", "[comment_scanner]")
+{
+    auto model = scan(R"(
+struct Types
+{
+    void f(const std::string& a, char const* const b, long unsigned int c,
+           std::map<std::string, unsigned> d, volatile int* e,
+           signed char g, long long h, Foo&& i);
+    const Bar* field;
+};
+)");
+    REQUIRE(model);
+    REQUIRE(model->classes.size() == 1);
+    auto const& params = model->classes[0].methods.at(0).params;
+    std::vector<std::string> types;
+    for (auto const& p : params)
+        types.push_back(p.type);
+    REQUIRE(types == std::vector<std::string>{
+                         "std::string const&", "char const* const",
+                         "unsigned long",
+                         "std::map<std::string, unsigned int>",
+                         "int volatile*", "signed char", "long long",
+                         "Foo&&"});
+    REQUIRE(model->classes[0].fields.at(0).type == "Bar const*");
+}
+
+TEST_CASE("Gives up on macros", "[comment_scanner]")
+{
+    REQUIRE(unsure("#define EXPORT\nclass EXPORT Foo {};\n") ==
+            "uses the macro EXPORT on line 2");
+    REQUIRE(unsure("struct Foo\n{\n    DECLARE_STUFF(Foo)\n};\n") ==
+            "'DECLARE_STUFF' looks like a macro on line 3");
+}
+
+TEST_CASE("Gives up on conditional compilation", "[comment_scanner]")
+{
+    REQUIRE(unsure("#if defined(WIN32)\nstruct Foo {};\n#endif\n") ==
+            "#if on line 1");
+    REQUIRE(unsure("#ifdef WIN32\nstruct Foo {};\n#endif\n") ==
+            "#ifdef on line 1");
+    // An #ifndef that guards nothing is not an include guard
+    REQUIRE(unsure("#ifndef A\nstruct Foo {};\n#endif\n") ==
+            "#ifndef that is not an include guard on line 2");
+    REQUIRE(unsure("#ifndef A\n#define A\n#endif\nstruct Foo {};\n") ==
+            "code after the include guard on line 4");
+    REQUIRE(unsure("#ifndef A\n#define A\nstruct Foo {};\n") ==
+            "unterminated #ifndef");
+}
+
+TEST_CASE("Gives up on includes it can not find", "[comment_scanner]")
+{
+    REQUIRE(unsure("#include \"no_such_header.h\"\n") ==
+            "can not find \"no_such_header.h\" next to the file on line 1");
+    REQUIRE(unsure("#include HEADER\n") == "#include of a macro on line 1");
+
+    // System headers are not followed, so they need not be found
+    auto model = scan("#include <no_such_header>\nstruct Foo {};\n");
+    REQUIRE(model);
+    REQUIRE(model->includes.empty());
+}
+
+TEST_CASE("Gives up on types it can not spell", "[comment_scanner]")
+{
+    // Nested template arguments are left to clang
+    REQUIRE(unsure("struct Foo\n{\n    std::vector<std::vector<int>> v;\n};\n") ==
+            "type 'std::vector<std::vector<int>>' on line 3");
+    REQUIRE(unsure("struct Foo\n{\n    std::vector<int>::iterator it;\n};\n") ==
+            "type 'std::vector<int>::iterator' on line 3");
+    REQUIRE(unsure("struct Foo\n{\n    void f(int (*callback)(int));\n};\n") ==
+            "function or array parameter on line 3");
+}
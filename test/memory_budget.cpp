@@ -0,0 +1,51 @@
+#include <catch2/catch.hpp>
+
+#include "../memory_budget.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+using namespace std::chrono_literals;
+
+TEST_CASE("A single job always runs", "[memory_budget]")
+{
+    // Any process is over a limit of one byte
+    MemoryBudget budget(1);
+    {
+        MemoryBudget::Scope room(budget);
+    }
+    MemoryBudget::Scope again(budget);
+}
+
+TEST_CASE("Jobs wait while over the limit", "[memory_budget]")
+{
+    MemoryBudget budget(1);
+    std::atomic<bool> started{false};
+    std::thread second;
+    {
+        MemoryBudget::Scope first(budget);
+        second = std::thread([&] {
+            MemoryBudget::Scope room(budget);
+            started = true;
+        });
+        std::this_thread::sleep_for(200ms);
+        REQUIRE(!started);
+    }
+    // Runs once the first job is done
+    second.join();
+    REQUIRE(started);
+}
+
+TEST_CASE("Jobs run side by side without a limit", "[memory_budget]")
+{
+    MemoryBudget budget;
+    MemoryBudget::Scope first(budget);
+    std::atomic<bool> started{false};
+    std::thread([&] {
+        MemoryBudget::Scope room(budget);
+        started = true;
+    }).join();
+    REQUIRE(started);
+    REQUIRE(MemoryBudget::currentRss() > 0);
+}
@@ -0,0 +1,172 @@
+#include <catch2/catch.hpp>
+
+#include "../cpp_parser.h"
+#include "../lua_template.h"
+#include "../renderer.h"
+
+#include <coreutils/output_buffer.h>
+
+#include <fmt/format.h>
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+namespace {
+
+void writeFile(std::string const& name, std::string const& contents)
+{
+    std::ofstream out(name, std::ios::binary);
+    out << contents;
+    REQUIRE(out);
+}
+
+std::string readFile(std::string const& name)
+{
+    std::ifstream in(name, std::ios::binary);
+    std::stringstream contents;
+    contents << in.rdbuf();
+    return contents.str();
+}
+
+std::vector<std::string> listFiles(std::string const& dir)
+{
+    std::vector<std::string> files;
+    if (auto* d = opendir(dir.c_str())) {
+        while (auto* entry = readdir(d))
+            if (entry->d_name[0] != '.')
+                files.push_back(dir + "/" + entry->d_name);
+        closedir(d);
+    }
+    return files;
+}
+
+// A project with one source file, in a directory of its own
+std::string makeProject(std::string const& name, std::string const& source)
+{
+    auto dir = resolvePath(".") + "/" + name;
+    mkdir(dir.c_str(), 0755);
+    // Left over from the last run
+    for (auto const& file : listFiles(dir + "/cache"))
+        std::remove(file.c_str());
+    writeFile(dir + "/main.cpp", source);
+    writeFile(dir + "/compile_commands.json",
+              fmt::format("[{{\n"
+                          "  \"directory\": \"{0}\",\n"
+                          "  \"command\": \"clang++ -std=c++14 -c {0}/main.cpp\",\n"
+                          "  \"file\": \"{0}/main.cpp\"\n"
+                          "}}]\n",
+                          dir));
+    return dir;
+}
+
+// Render `doc` the way dox does: parse only what it refers to, then run it
+std::string render(CppParser& parser, std::string const& dir,
+                   std::string const& doc)
+{
+    auto references = findReferences(doc);
+    REQUIRE(!references.dynamic);
+    parser.setWanted(references.symbols);
+    parser.loadFiles({dir + "/main.cpp"});
+    {
+        utils::OutputBuffer out(dir + "/out.txt");
+        Renderer renderer;
+        renderer.render(parser, "test.dox", doc, out, nullptr);
+    }
+    return readFile(dir + "/out.txt");
+}
+
+} // namespace
+
+TEST_CASE("Member comment by qualified name", "[renderer]")
+{
+    auto dir = makeProject("qualified_member", R"(
+struct Foo
+{
+    /// Bars the foo
+    void bar();
+};
+
+namespace ns {
+/// Another foo
+struct Foo
+{
+    void baz();
+};
+}
+
+/// Not referred to
+struct Other {};
+)");
+    std::string doc = R"(@{ print(doc_comment("Foo::bar")) })";
+
+    CppParser parser(dir);
+    REQUIRE(render(parser, dir, doc) == "Bars the foo");
+    // Classes the member may be in are converted, nothing else is
+    REQUIRE(parser.findClass("Foo"));
+    REQUIRE(parser.findClass("ns::Foo"));
+    REQUIRE(!parser.findClass("Other"));
+}
+
+TEST_CASE("Partial models are cached", "[renderer]")
+{
+    auto dir = makeProject("partial_cache", R"(
+/// Wanted
+struct Foo {};
+
+/// Not wanted
+struct Other {};
+)");
+    std::string doc = R"(@{ print(doc_comment("Foo")) })";
+
+    {
+        CppParser parser(dir);
+        parser.setCacheDir(dir + "/cache");
+        REQUIRE(render(parser, dir, doc) == "Wanted");
+    }
+    REQUIRE(listFiles(dir + "/cache").size() == 1);
+
+    // Read back from the cache; still partial, so a class that was skipped
+    // is parsed again when it is asked for
+    CppParser parser(dir);
+    parser.setCacheDir(dir + "/cache");
+    REQUIRE(render(parser, dir, doc) == "Wanted");
+    REQUIRE(listFiles(dir + "/cache").size() == 1);
+    REQUIRE(!parser.findClass("Other"));
+    REQUIRE(parser.resolveClass("Other"));
+    REQUIRE(listFiles(dir + "/cache").size() == 2);
+}
+
+TEST_CASE("Nested class by its short name", "[renderer]")
+{
+    auto dir = makeProject("nested_class", R"(
+struct Outer
+{
+    /// Nested docs
+    struct Foo {};
+};
+
+/// Not referred to
+struct Other {};
+)");
+    std::string doc = R"(@{ print(doc_comment("Foo")) })";
+
+    CppParser parser(dir);
+    REQUIRE(render(parser, dir, doc) == "Nested docs");
+    REQUIRE(parser.findClass("Foo"));
+    REQUIRE(!parser.findClass("Other"));
+}
+
+TEST_CASE("Text followed by code in parentheses", "[renderer]")
+{
+    auto dir = makeProject("text_then_paren", "struct Foo {};\n");
+    // Lua would read the parentheses as a call on the text before them
+    std::string doc = R"(x@{ (print)("y") })";
+
+    CppParser parser(dir);
+    REQUIRE(render(parser, dir, doc) == "xy");
+}
@@ -0,0 +1,129 @@
+#include <catch2/catch.hpp>
+
+#include "../symbol_index.h"
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+Method method(std::string const& name, std::string const& param = "")
+{
+    Method m;
+    m.name = name;
+    if (!param.empty())
+        m.params.push_back({param, "int", ""});
+    return m;
+}
+
+std::unordered_map<std::string, FileModel> makeModels()
+{
+    std::unordered_map<std::string, FileModel> models;
+
+    auto& a = models["a.h"];
+    a.path = "a.h";
+    a.classes.emplace_back("", "Foo");
+    a.classes.back().methods = {method("bar"), method("bar", "x")};
+    a.classes.back().fields.push_back({"size", "int", ""});
+    a.classes.emplace_back("ns", "Foo");
+    a.classes.back().methods = {method("baz")};
+
+    auto& b = models["b.h"];
+    b.path = "b.h";
+    b.classes.emplace_back("ns::inner", "Bar");
+    b.classes.back().methods = {method("bar")};
+    b.classes.emplace_back("ns", "FooBar");
+    return models;
+}
+
+std::vector<std::string> names(SymbolIndex::Symbols symbols)
+{
+    std::vector<std::string> result;
+    for (auto const& s : symbols)
+        result.emplace_back(s.name);
+    return result;
+}
+
+} // namespace
+
+TEST_CASE("Qualified lookup", "[symbol_index]")
+{
+    auto models = makeModels();
+    SymbolIndex index;
+    index.build(models);
+    REQUIRE(index.size() == 9);
+
+    auto overloads = index.find("Foo::bar");
+    REQUIRE(overloads.size() == 2);
+    REQUIRE(overloads.begin()->kind == SymbolIndex::Kind::Method);
+    REQUIRE(overloads.begin()->unqualified() == "bar");
+    REQUIRE(overloads.begin()->owner->name == "Foo");
+
+    auto field = index.find("Foo::size");
+    REQUIRE(field.size() == 1);
+    REQUIRE(field.begin()->field().type == "int");
+    REQUIRE(field.begin()->file == "a.h");
+
+    REQUIRE(index.find("ns::inner::Bar").size() == 1);
+    REQUIRE(index.find("Bar").empty());
+    REQUIRE(index.find("Foo::ba").empty());
+}
+
+TEST_CASE("Scope relative lookup", "[symbol_index]")
+{
+    auto models = makeModels();
+    SymbolIndex index;
+    index.build(models);
+
+    // The innermost scope wins
+    REQUIRE(names(index.find("Foo", "ns")) ==
+            std::vector<std::string>{"ns::Foo"});
+    REQUIRE(names(index.find("Foo", "")) == std::vector<std::string>{"Foo"});
+    // Found in an enclosing scope
+    REQUIRE(names(index.find("Foo", "ns::inner::Bar")) ==
+            std::vector<std::string>{"ns::Foo"});
+    REQUIRE(names(index.find("Foo::size", "ns::inner")) ==
+            std::vector<std::string>{"Foo::size"});
+    REQUIRE(index.find("bar", "ns::inner::Bar").size() == 1);
+    REQUIRE(index.find("bar", "Foo").size() == 2);
+    // Explicitly global skips the scopes
+    REQUIRE(names(index.find("::Foo", "ns")) ==
+            std::vector<std::string>{"Foo"});
+    REQUIRE(index.find("baz", "Foo").empty());
+}
+
+TEST_CASE("Prefix and name lookup", "[symbol_index]")
+{
+    auto models = makeModels();
+    SymbolIndex index;
+    index.build(models);
+
+    REQUIRE(names(index.withPrefix("ns::Foo")) ==
+            std::vector<std::string>{"ns::Foo", "ns::Foo::baz", "ns::FooBar"});
+    REQUIRE(names(index.withPrefix("Foo::")) ==
+            std::vector<std::string>{"Foo::bar", "Foo::bar", "Foo::size"});
+    REQUIRE(index.withPrefix("").size() == index.size());
+    REQUIRE(index.withPrefix("zzz").empty());
+
+    std::vector<std::string> bars;
+    for (auto const* s : index.named("bar"))
+        bars.emplace_back(s->name);
+    REQUIRE(bars ==
+            std::vector<std::string>{"Foo::bar", "Foo::bar", "ns::inner::Bar::bar"});
+    REQUIRE(index.named("Bar").size() == 1);
+    REQUIRE(index.named("missing").empty());
+}
+
+TEST_CASE("Long names", "[symbol_index]")
+{
+    std::unordered_map<std::string, FileModel> models;
+    std::string ns(70000, 'n');
+    models["long.h"].classes.emplace_back(ns, "Foo");
+
+    SymbolIndex index;
+    index.build(models);
+    auto found = index.find(ns + "::Foo");
+    REQUIRE(found.size() == 1);
+    REQUIRE(found.begin()->unqualified() == "Foo");
+}
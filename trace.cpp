@@ -0,0 +1,221 @@
+#include "trace.h"
+
+#include <fmt/format.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Counted by the replacement operator new below, only while recording
+thread_local size_t allocations = 0;
+thread_local size_t allocatedBytes = 0;
+
+struct Open
+{
+    char const* phase;
+    std::string file;
+    Clock::time_point start;
+    size_t allocations;
+    size_t bytes;
+};
+
+struct Event
+{
+    char const* phase;
+    std::string file;
+    int thread;
+    long long start; // Microseconds since `trace::start()`
+    long long duration;
+    size_t allocations;
+    size_t bytes;
+};
+
+struct Recorder
+{
+    std::mutex mutex;
+    std::string baseName;
+    std::string fileName;
+    int sequence = 0;
+    Clock::time_point origin;
+    std::vector<Event> events;
+    int threads = 0;
+};
+
+// Constant initialized, so it can be read by allocations made before main
+std::atomic<bool> recording{false};
+
+Recorder& recorder()
+{
+    static Recorder r;
+    return r;
+}
+
+thread_local std::vector<Open> open;
+thread_local int threadId = -1;
+
+long long micros(Clock::duration d)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+}
+
+std::string escape(std::string_view text)
+{
+    std::string result;
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            result += '\\';
+            result += c;
+        } else if (static_cast<unsigned char>(c) < 0x20)
+            result += fmt::format("\\u{:04x}", static_cast<int>(c));
+        else
+            result += c;
+    }
+    return result;
+}
+
+// `trace.json` and 2 gives `trace.2.json`
+std::string numbered(std::string const& name, int n)
+{
+    auto dot = name.rfind('.');
+    auto slash = name.find_last_of("/\\");
+    if (dot == std::string::npos || dot == 0 ||
+        (slash != std::string::npos && dot < slash + 2))
+        return fmt::format("{}.{}", name, n);
+    return fmt::format("{}.{}{}", name.substr(0, dot), n, name.substr(dot));
+}
+
+void writeEvents(Recorder& r)
+{
+    auto* f = std::fopen(r.fileName.c_str(), "wb");
+    if (!f)
+        throw std::runtime_error("Could not write " + r.fileName);
+    fmt::print(f, "{{\"traceEvents\":[");
+    const char* separator = "\n";
+    for (auto const& e : r.events) {
+        fmt::print(f,
+                   "{}{{\"name\":\"{}\",\"cat\":\"dox\",\"ph\":\"X\","
+                   "\"pid\":1,\"tid\":{},\"ts\":{},\"dur\":{},\"args\":{{"
+                   "\"file\":\"{}\",\"allocations\":{},\"bytes\":{}}}}}",
+                   separator, e.phase, e.thread, e.start, e.duration,
+                   escape(e.file), e.allocations, e.bytes);
+        separator = ",\n";
+    }
+    fmt::print(f, "\n],\"displayTimeUnit\":\"ms\"}}\n");
+    std::fclose(f);
+}
+
+} // namespace
+
+void* operator new(std::size_t size)
+{
+    // All that is left when not recording is this one load
+    if (recording.load(std::memory_order_relaxed)) {
+        allocations++;
+        allocatedBytes += size;
+    }
+    while (true) {
+        if (auto* p = std::malloc(size > 0 ? size : 1))
+            return p;
+        auto handler = std::get_new_handler();
+        if (!handler)
+            throw std::bad_alloc();
+        handler();
+    }
+}
+
+void* operator new(std::size_t size, std::nothrow_t const&) noexcept
+{
+    try {
+        return ::operator new(size);
+    } catch (std::bad_alloc const&) {
+        return nullptr;
+    }
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+namespace trace {
+
+void start(std::string const& fileName)
+{
+    auto& r = recorder();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    r.baseName = fileName;
+    r.fileName = fileName;
+    r.sequence = 0;
+    r.origin = Clock::now();
+    r.events.clear();
+    recording = true;
+}
+
+bool enabled()
+{
+    return recording.load(std::memory_order_relaxed);
+}
+
+void begin(char const* phase, std::string_view file)
+{
+    if (!enabled())
+        return;
+    open.push_back(Open{phase, std::string(file), Clock::now(), allocations,
+                        allocatedBytes});
+}
+
+void end()
+{
+    if (open.empty())
+        return;
+    auto now = Clock::now();
+    auto& o = open.back();
+    auto count = allocations - o.allocations;
+    auto bytes = allocatedBytes - o.bytes;
+
+    auto& r = recorder();
+    {
+        std::lock_guard<std::mutex> lock(r.mutex);
+        if (threadId < 0)
+            threadId = r.threads++;
+        r.events.push_back(Event{o.phase, std::move(o.file), threadId,
+                                 micros(o.start - r.origin),
+                                 micros(now - o.start), count, bytes});
+    }
+    open.pop_back();
+}
+
+void write()
+{
+    auto& r = recorder();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    if (!r.fileName.empty())
+        writeEvents(r);
+}
+
+void rotate()
+{
+    auto& r = recorder();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    if (r.fileName.empty())
+        return;
+    writeEvents(r);
+    r.events.clear();
+    r.fileName = numbered(r.baseName, ++r.sequence);
+}
+
+} // namespace trace
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+// Records a timeline of where a run spends its time, per phase and per file,
+// and writes it as a Chrome trace; open it in chrome://tracing or
+// ui.perfetto.dev. Every event also counts the heap allocations its thread
+// made while it ran.
+// Nothing is recorded until `start()` is called, so the probes can stay in.
+namespace trace {
+
+// Start recording; `write()` saves what was recorded so far to `fileName`
+void start(std::string const& fileName);
+bool enabled();
+void write();
+// Write, then forget what was written and record on into the next file of
+// a numbered series: trace.json, trace.1.json, trace.2.json...
+void rotate();
+
+// Phases on one thread must nest. `phase` must be a string literal.
+void begin(char const* phase, std::string_view file = {});
+void end();
+
+// A phase that lasts as long as the scope
+class Scope
+{
+public:
+    explicit Scope(char const* phase, std::string_view file = {})
+        : active_(enabled())
+    {
+        if (active_)
+            begin(phase, file);
+    }
+    ~Scope()
+    {
+        if (active_)
+            end();
+    }
+    Scope(Scope const&) = delete;
+    Scope& operator=(Scope const&) = delete;
+
+private:
+    bool active_;
+};
+
+} // namespace trace